@@ -4,6 +4,215 @@
 
 #include "BigInteger.h"
 
+static BigInteger parse_radix(string_view s, int base);
+
+static TYPE add_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m);
+
+static TYPE sub_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m);
+
+static int cmp_limbs(const TYPE *a, int n, const TYPE *b, int m);
+
+LimbVector::LimbVector(size_t n, TYPE value) : LimbVector() {
+    resize(n, value);
+}
+
+LimbVector::LimbVector(const TYPE *first, const TYPE *last) : LimbVector() {
+    assign(first, last);
+}
+
+LimbVector::LimbVector(const LimbVector &other) : LimbVector() {
+    assign(other.begin(), other.end());
+}
+
+LimbVector::LimbVector(LimbVector &&other) noexcept : LimbVector() {
+    // a moved-to vector adopts the resource of its source, as std::pmr containers do
+    res = other.res;
+    *this = std::move(other);
+}
+
+LimbVector &LimbVector::operator=(const LimbVector &other) {
+    if (this != &other) {
+        assign(other.begin(), other.end());
+    }
+    return *this;
+}
+
+LimbVector &LimbVector::operator=(LimbVector &&other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (other.is_inline() || other.res != res) {
+        // nothing to steal, or a block we could not give back: copy into our own storage
+        assign(other.begin(), other.end());
+    } else {
+        release();
+        ptr = other.ptr;
+        len = other.len;
+        cap = other.cap;
+        other.ptr = other.buf;
+        other.cap = INLINE_LIMBS;
+    }
+    other.len = 0;
+    return *this;
+}
+
+LimbVector::~LimbVector() {
+    release();
+}
+
+void LimbVector::assign(const TYPE *first, const TYPE *last) {
+    size_t n = last - first;
+    if (n > cap) {
+        len = 0; // nothing worth keeping
+        grow(n);
+    }
+    copy(first, last, ptr);
+    len = (uint32_t)n;
+}
+
+void LimbVector::grow(size_t n) {
+    size_t c = max(n, (size_t)cap * 2);
+    TYPE *p = res ? (TYPE *)res->allocate(c * sizeof(TYPE), alignof(TYPE)) : new TYPE[c];
+    copy(ptr, ptr + len, p);
+    release();
+    ptr = p;
+    cap = (uint32_t)c;
+}
+
+// gives a heap block back to where it came from
+void LimbVector::release() {
+    if (is_inline()) {
+        return;
+    }
+    if (res) {
+        res->deallocate(ptr, cap * sizeof(TYPE), alignof(TYPE));
+    } else {
+        delete[] ptr;
+    }
+}
+
+// Bump allocator behind ScratchScope: blocks are carved off the current chunk in order and
+// only come back all at once in reset(), or right away when the most recent one is freed,
+// which covers the temporaries of a loop body. A fresh chunk doubles the previous one, and
+// reset() merges them so that the next scope finds a single chunk of the high-water size,
+// capped at BIGINT_SCRATCH_RETAIN_BYTES so one huge scope doesn't pin its memory for good.
+class ScratchArena : public std::pmr::memory_resource {
+public:
+    static ScratchArena &local() {
+        static thread_local ScratchArena arena;
+        return arena;
+    }
+
+    bool busy = false; // an outermost ScratchScope is alive on this thread
+
+    void reserve(size_t bytes) {
+        if (chunks.size() == 1 && used == 0 && chunks[0].size < bytes) {
+            chunks.clear();
+        }
+        if (chunks.empty()) {
+            add_chunk(bytes);
+        }
+    }
+
+    void reset() {
+        size_t total = 0;
+        for (const Chunk &c : chunks) {
+            total += c.size;
+        }
+        size_t keep = min(total, (size_t)BIGINT_SCRATCH_RETAIN_BYTES);
+        if (chunks.size() > 1 || keep < total) {
+            chunks.clear();
+            add_chunk(keep);
+        }
+        cur = 0;
+        used = 0;
+    }
+
+    void release() {
+        chunks.clear();
+        cur = 0;
+        used = 0;
+    }
+
+private:
+    struct Chunk {
+        unique_ptr<byte[]> data;
+        size_t size;
+    };
+    vector<Chunk> chunks;
+    size_t cur = 0;  // chunk being carved
+    size_t used = 0; // bytes taken from it
+
+    void add_chunk(size_t bytes) {
+        bytes = max(bytes, (size_t)4096);
+        chunks.push_back({unique_ptr<byte[]>(new byte[bytes]), bytes});
+    }
+
+    void *do_allocate(size_t bytes, size_t align) override {
+        if (cur >= chunks.size() || offset(align) + bytes > chunks[cur].size) {
+            // the rest of this chunk is wasted until reset()
+            add_chunk(max(bytes + align, chunks.empty() ? 0 : 2 * chunks.back().size));
+            cur = chunks.size() - 1;
+            used = 0;
+        }
+        size_t start = offset(align);
+        used = start + bytes;
+        return chunks[cur].data.get() + start;
+    }
+
+    // next offset in the current chunk with the given address alignment
+    size_t offset(size_t align) const {
+        uintptr_t base = (uintptr_t)chunks[cur].data.get();
+        return ((base + used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t) override {
+        if (cur < chunks.size() && (byte *)p + bytes == chunks[cur].data.get() + used) {
+            used = (byte *)p - chunks[cur].data.get();
+        }
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+LimbResourceScope::LimbResourceScope(std::pmr::memory_resource *resource) {
+    previous = LimbVector::current;
+    LimbVector::current = resource;
+}
+
+LimbResourceScope::~LimbResourceScope() {
+    LimbVector::current = previous;
+}
+
+ScratchScope::ScratchScope(size_t reserveLimbs) {
+    ScratchArena &arena = ScratchArena::local();
+    previous = LimbVector::current;
+    owner = !arena.busy;
+    if (owner) {
+        arena.busy = true;
+        arena.reserve(reserveLimbs * sizeof(TYPE));
+        LimbVector::current = &arena;
+    }
+}
+
+ScratchScope::~ScratchScope() {
+    if (owner) {
+        LimbVector::current = previous;
+        ScratchArena &arena = ScratchArena::local();
+        arena.reset();
+        arena.busy = false;
+    }
+}
+
+void ScratchScope::releaseMemory() {
+    ScratchArena &arena = ScratchArena::local();
+    if (!arena.busy) {
+        arena.release();
+    }
+}
+
 BigInteger::BigInteger() {
     digits.clear();
     sign = 1;
@@ -33,45 +242,33 @@ BigInteger::BigInteger(const string &s) {
 
 BigInteger::BigInteger(const string &s, int base, int sign)
 {
-    this->sign = sign;
-    string temp = s;
-
-    reverse(temp.begin(), temp.end());
-    
-    BigInteger base_num(base);
-
-    BigInteger temp_num("0");
-
-    for (int i = 0; i< temp.size(); i++) {
-        string c = to_string(temp[i] - '0');
-        temp_num = temp_num + base_num.pow(i) * BigInteger(stoll(c));
-    }
-
-    digits = temp_num.getDigits();
+    *this = parse_radix(s, base);
+    this->sign = is_zero() ? 1 : sign;
 }
 
-BigInteger::BigInteger(TYPE l) {
-    if (l < 0) {
-        sign = -1;
-        l = -l;
-    } else {
-        sign = 1;
-    }
+BigInteger::BigInteger(ll l) {
+    sign = l < 0 ? -1 : 1;
+    digits.push_back(l < 0 ? 0 - (ull)l : (ull)l);
+}
 
-    if (l == 0) {
-        digits.push_back(0);
-        return;
-    }
+BigInteger::BigInteger(const BigInteger &other) {
+    digits = other.digits;
+    sign = other.sign;
+}
 
-    while (l > 0) {
-        digits.push_back(l % (1ll << BIT_PER_DIGIT));
-        l /= (1ll << BIT_PER_DIGIT);
-    }
+BigInteger::BigInteger(BigInteger &&other) noexcept : digits(std::move(other.digits)), sign(other.sign) {
 }
 
-BigInteger::BigInteger(const BigInteger &other) {
+BigInteger &BigInteger::operator=(const BigInteger &other) {
     digits = other.digits;
     sign = other.sign;
+    return *this;
+}
+
+BigInteger &BigInteger::operator=(BigInteger &&other) {
+    digits = std::move(other.digits);
+    sign = other.sign;
+    return *this;
 }
 
 BigInteger BigInteger::abs() const {
@@ -80,15 +277,23 @@ BigInteger BigInteger::abs() const {
     return res;
 }
 
-void BigInteger::setDigits(const vector<TYPE> &digit) {
-    BigInteger::digits = digit;
+void BigInteger::setLimbs(const vector<TYPE> &limbs) {
+    digits.assign(limbs.data(), limbs.data() + limbs.size());
+}
+
+void BigInteger::setLimbs(const LimbVector &limbs) {
+    digits = limbs;
+}
+
+void BigInteger::setLimbs(LimbVector &&limbs) {
+    digits = std::move(limbs);
 }
 
 void BigInteger::setSign(int s) {
     BigInteger::sign = s;
 }
 
-const vector<TYPE> &BigInteger::getDigits() const {
+const LimbVector &BigInteger::getLimbs() const {
     return digits;
 }
 
@@ -98,19 +303,8 @@ int BigInteger::getSign() const {
 
 bool BigInteger::operator<(const BigInteger &a) const {
     if (sign != a.sign) return sign < a.sign;
-
-    bool is_negative = (sign == -1);
-
-    int n = size();
-    int m = a.size();
-    if (n < m) return !is_negative;
-    if (n > m) return is_negative;
-
-    for (int i = n - 1; i >= 0; i--) {
-        if (digits[i] < a.digits[i]) return !is_negative;
-        if (digits[i] > a.digits[i]) return is_negative;
-    }
-    return false;
+    int c = cmp_limbs(digits.data(), size(), a.digits.data(), a.size());
+    return sign == -1 ? c > 0 : c < 0;
 }
 
 int BigInteger::size() const {
@@ -119,17 +313,8 @@ int BigInteger::size() const {
 
 bool BigInteger::operator<=(const BigInteger &a) const {
     if (sign != a.sign) return sign < a.sign;
-    bool is_negative = (sign == -1);
-
-    int n = size();
-    int m = a.size();
-    if (n < m) return !is_negative;
-    if (n > m) return is_negative;
-    for (int i = n - 1; i >= 0; i--) {
-        if (digits[i] < a.digits[i]) return !is_negative;
-        if (digits[i] > a.digits[i]) return is_negative;
-    }
-    return true;
+    int c = cmp_limbs(digits.data(), size(), a.digits.data(), a.size());
+    return sign == -1 ? c >= 0 : c <= 0;
 }
 
 bool BigInteger::operator>(const BigInteger &a) const {
@@ -140,67 +325,59 @@ bool BigInteger::operator>=(const BigInteger &a) const {
     return !(*this < a);
 }
 
-BigInteger BigInteger::operator+(const BigInteger &a) const {
-    int n = size();
-    int m = a.size();
-    BigInteger ans;
-    ans.digits.resize(max(n, m) + 1);
-
-    if (sign == a.sign) {
-        ans.sign = sign;
-        ll carry = 0;
-        ll sum = 0;
-        for (int i = 0; i < max(n, m); i++) {
-            sum = carry;
-            if (i < n) sum += digits[i];
-            if (i < m) sum += a.digits[i];
-            ans.digits[i] = sum % BASE;
-            carry = sum / BASE;
-        }
-        ans.digits[max(n, m)] = carry;
-        ans.trim();
-        return ans;
-    } 
-    if (this->abs() >= a.abs()) {
-        ans.sign = sign;
-        ll carry = 0;
-        ll sum = 0;
-        for (int i = 0; i < n; i++) {
-            sum = carry + digits[i];
-            if (i < m) sum -= a.digits[i];
-            if (sum < 0) { 
-                sum += BASE;
-                carry = -1;
-            } else {
-                carry = 0;
-            }
-            ans.digits[i] = sum;
-        }
-        ans.trim();
-        return ans;
-    }
-    ans.sign = a.sign;
-    int carry = 0;
-    ll sum = 0;
-    for (int i = 0; i < m; i++) {
-        sum = carry + a.digits[i];
-        if (i < n) sum -= digits[i];
-        if (sum < 0) {
-            sum += BASE;
-            carry = -1;
+void BigInteger::add_signed(BigInteger &r, const BigInteger &x, const BigInteger &y, int y_sign) {
+    int n = x.size();
+    int m = y.size();
+    while (n > 0 && x.digits[n - 1] == 0) n--;
+    while (m > 0 && y.digits[m - 1] == 0) m--;
+    int x_sign = x.sign;
+    // growing r may move x and y when they alias it, so only take their limbs afterwards
+    r.digits.resize(max(max(n, m) + 1, r.size()));
+    TYPE *rd = r.digits.data();
+    const TYPE *xd = x.digits.data(), *yd = y.digits.data();
+
+    // the limb helpers walk upward and read each position before writing it, so r may alias x or y
+    if (x_sign == y_sign) {
+        r.sign = x_sign;
+        if (n >= m) {
+            rd[n] = add_limbs(rd, xd, n, yd, m);
         } else {
-            carry = 0;
+            rd[m] = add_limbs(rd, yd, m, xd, n);
         }
-        ans.digits[i] = sum;
+    } else if (cmp_limbs(xd, n, yd, m) >= 0) {
+        // trimmed, so the larger magnitude has at least as many limbs
+        r.sign = x_sign;
+        sub_limbs(rd, xd, n, yd, m);
+        rd[n] = 0;
+    } else {
+        r.sign = y_sign;
+        sub_limbs(rd, yd, m, xd, n);
+        rd[m] = 0;
     }
-    ans.trim();
+    r.digits.resize(max(n, m) + 1);
+    r.trim();
+}
+
+BigInteger BigInteger::operator+(const BigInteger &a) const {
+    BigInteger ans;
+    add_signed(ans, *this, a, a.sign);
     return ans;
 }
 
 BigInteger BigInteger::operator-(const BigInteger &a) const {
-    BigInteger temp(a);
-    temp.sign = -temp.sign;
-    return *this + temp; 
+    BigInteger ans;
+    add_signed(ans, *this, a, -a.sign);
+    return ans;
+}
+
+BigInteger &BigInteger::operator+=(const BigInteger &a) {
+    add_signed(*this, *this, a, a.sign);
+    return *this;
+}
+
+BigInteger &BigInteger::operator-=(const BigInteger &a) {
+    add_signed(*this, *this, a, -a.sign);
+    return *this;
 }
 
 void BigInteger::trim() {
@@ -213,477 +390,3132 @@ void BigInteger::trim() {
     }
 }
 
-BigInteger BigInteger::operator*(const BigInteger &a) const {
-    BigInteger res;
-    if (digits.empty() || a.getDigits().empty()) {
-        return res;
-    }
+static MultiplyThresholds mul_thresholds;
 
-    BigInteger temp(*this);
+void setMultiplyThresholds(const MultiplyThresholds &t) {
+    // every tier must see strictly smaller operands when it recurses
+    mul_thresholds.karatsuba = max(t.karatsuba, 4);
+    mul_thresholds.toom3 = max(t.toom3, mul_thresholds.karatsuba);
+    mul_thresholds.ntt = max(t.ntt, 2);
+}
 
-    vector<TYPE> y = a.getDigits();
+MultiplyThresholds getMultiplyThresholds() {
+    return mul_thresholds;
+}
 
-    for (size_t i = 0; i < y.size() * BIT_PER_DIGIT; ++i) {
-        if (y[i / BIT_PER_DIGIT] & (1ll << (i % BIT_PER_DIGIT))) {
-            res = res + temp;
-        }
-        temp = temp + temp;
-    }
+// The helpers below work on little-endian arrays of 64-bit limbs.
+
+// a + b + carry with carry in {0, 1}, which receives the carry out; one adc per limb
+static inline TYPE add_carry(TYPE a, TYPE b, TYPE &carry) {
+#if defined(__has_builtin) && __has_builtin(__builtin_addcll)
+    ull out;
+    TYPE s = __builtin_addcll(a, b, carry, &out);
+    carry = out;
+    return s;
+#elif defined(__x86_64__)
+    ull s;
+    carry = _addcarry_u64((unsigned char)carry, a, b, &s);
+    return s;
+#else
+    u128 s = (u128)a + b + carry;
+    carry = (TYPE)(s >> BIT_PER_DIGIT);
+    return (TYPE)s;
+#endif
+}
 
-    return res;
+// a - b - borrow with borrow in {0, 1}, which receives the borrow out; one sbb per limb
+static inline TYPE sub_borrow(TYPE a, TYPE b, TYPE &borrow) {
+#if defined(__has_builtin) && __has_builtin(__builtin_subcll)
+    ull out;
+    TYPE d = __builtin_subcll(a, b, borrow, &out);
+    borrow = out;
+    return d;
+#elif defined(__x86_64__)
+    ull d;
+    borrow = _subborrow_u64((unsigned char)borrow, a, b, &d);
+    return d;
+#else
+    TYPE d = a - b - borrow;
+    borrow = (a < b) | ((a == b) & borrow);
+    return d;
+#endif
 }
 
-string BigInteger::toString() const {
-    if (is_zero()) return "0";
-    string binary = "";
-    for (TYPE val: digits) {
-        for (int i = 0; i < BIT_PER_DIGIT; i++) {
-            binary += (val & (TYPE(1) << i)) ? '1' : '0';
-        }
-    }
+// Scalar kernels for the linear passes: add/sub of equal-length operands, comparison of
+// equal-length operands and shifts by 1..63 bits. The SIMD versions below compute the same
+// results and are picked at run time; every kernel reads a block before writing it and walks
+// in the direction that keeps r == a (and the overlaps the shifts are called with) safe.
 
-    while (binary.size() > 1 && binary.back() == '0') {
-        binary.pop_back();
+static TYPE add_n_scalar(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    TYPE carry = 0;
+    for (int i = 0; i < n; i++) {
+        r[i] = add_carry(a[i], b[i], carry);
     }
+    return carry;
+}
 
-    reverse(binary.begin(), binary.end());
-    if (sign == -1) {
-        binary = '-' + binary;
+static TYPE sub_n_scalar(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    TYPE borrow = 0;
+    for (int i = 0; i < n; i++) {
+        r[i] = sub_borrow(a[i], b[i], borrow);
     }
-    return binary;
+    return borrow;
 }
 
-bool BigInteger::is_zero() const {
-    return digits.empty() || (digits.size() == 1 && digits[0] == 0);
+static int cmp_n_scalar(const TYPE *a, const TYPE *b, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
 }
 
-BigInteger BigInteger::addMod(const BigInteger &other, const BigInteger &mod) const {
-    if (this->is_zero()) {
-        return other.mod(mod);
-    }
-    if (other.is_zero()) {
-        return this->mod(mod);
+// low to high, so r may alias a
+static TYPE lshift_scalar(TYPE *r, const TYPE *a, int n, int s) {
+    TYPE carry = 0;
+    for (int i = 0; i < n; i++) {
+        TYPE v = a[i];
+        r[i] = (v << s) | carry;
+        carry = v >> (BIT_PER_DIGIT - s);
     }
-    BigInteger temp(*this);
-    BigInteger res = temp + other;
-    return res.mod(mod);
+    return carry;
 }
 
-BigInteger BigInteger::mod(const BigInteger &mod) const {
-    BigInteger temp(*this);
-
-    BigInteger abs_mod = mod.abs();
-
-    while (temp >= abs_mod) {
-        temp = temp - abs_mod;
+// low to high, so r may alias a or sit below it
+static void rshift_scalar(TYPE *r, const TYPE *a, int n, int s) {
+    for (int i = 0; i + 1 < n; i++) {
+        r[i] = (a[i] >> s) | (a[i + 1] << (BIT_PER_DIGIT - s));
     }
-    return temp;
+    r[n - 1] = a[n - 1] >> s;
 }
 
-BigInteger BigInteger::mulMod(const BigInteger &other, const BigInteger &mod) const {
-    BigInteger res;
-    if (this->is_zero() || other.is_zero())
-        return res;
-    BigInteger temp(*this);
-    BigInteger abs_mod = mod.abs();
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(BIGINT_NO_SIMD)
+#define BIGINT_X86_SIMD
+
+// Carry-lookahead over a block of lanes: g marks the lanes whose sum wrapped (they generate a
+// carry into the next lane), p the lanes that are all ones (they pass an incoming carry on).
+// Adding p to the incoming carries ripples each carry through its run of p lanes in a single
+// integer addition; xor with p then leaves exactly the lanes that receive a carry. A lane
+// can't both wrap and be all ones, so g and p are disjoint and one add suffices. The same
+// works for borrows with g = (a < b) and p = (a - b == 0). Returns the lanes to adjust and
+// leaves the carry out of the top lane in carry.
+static inline unsigned lookahead(unsigned g, unsigned p, unsigned &carry, int lanes) {
+    unsigned x = (g << 1 | carry) + p;
+    carry = x >> lanes;
+    return (x ^ p) & ((1u << lanes) - 1);
+}
 
-    vector<TYPE> y = other.getDigits();
+__attribute__((target("avx2")))
+static __m256i lane_mask_avx2(unsigned bits) {
+    // lanes i with bit i of bits set become all ones
+    const __m256i sel = _mm256_setr_epi64x(1, 2, 4, 8);
+    return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), sel), sel);
+}
 
-    for (size_t i = 0; i < y.size() * BIT_PER_DIGIT; ++i) {
-        if (y[i / BIT_PER_DIGIT] & (1ll << (i % BIT_PER_DIGIT))) {
-            res = res.addMod(temp, abs_mod);
+__attribute__((target("avx2")))
+static TYPE add_n_avx2(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    // AVX2 has no unsigned compare, so both sides are biased by 2^63 first
+    const __m256i bias = _mm256_set1_epi64x(LLONG_MIN), ones = _mm256_set1_epi64x(-1);
+    unsigned carry = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i sum[4];
+        unsigned g = 0, p = 0;
+        for (int k = 0; k < 4; k++) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(a + i + 4 * k));
+            __m256i y = _mm256_loadu_si256((const __m256i *)(b + i + 4 * k));
+            sum[k] = _mm256_add_epi64(x, y);
+            __m256i wrapped = _mm256_cmpgt_epi64(_mm256_xor_si256(x, bias), _mm256_xor_si256(sum[k], bias));
+            g |= _mm256_movemask_pd(_mm256_castsi256_pd(wrapped)) << 4 * k;
+            p |= _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(sum[k], ones))) << 4 * k;
+        }
+        unsigned inc = lookahead(g, p, carry, 16);
+        for (int k = 0; k < 4; k++) {
+            // subtracting an all-ones lane adds 1
+            __m256i v = _mm256_sub_epi64(sum[k], lane_mask_avx2(inc >> 4 * k & 15));
+            _mm256_storeu_si256((__m256i *)(r + i + 4 * k), v);
         }
-        temp = temp.addMod(temp, abs_mod);
     }
-    return res;
+    TYPE c = carry;
+    for (; i < n; i++) {
+        r[i] = add_carry(a[i], b[i], c);
+    }
+    return c;
 }
 
-BigInteger BigInteger::powMod(const BigInteger &a, const BigInteger &mod) const {
-    BigInteger res("1");
-    BigInteger temp(*this);
-    if (a.is_zero())
-        return res;
-    BigInteger abs_mod = mod.abs();
-    vector<TYPE> y = a.getDigits();
-
-    for (int i = y.size() * BIT_PER_DIGIT - 1; i >= 0; --i) {
-        if (res.size() != 1 || res.getDigits()[0] != 1) {
-            res = res.mulMod(res, mod);
+__attribute__((target("avx2")))
+static TYPE sub_n_avx2(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    const __m256i bias = _mm256_set1_epi64x(LLONG_MIN), zero = _mm256_setzero_si256();
+    unsigned borrow = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i diff[4];
+        unsigned g = 0, p = 0;
+        for (int k = 0; k < 4; k++) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(a + i + 4 * k));
+            __m256i y = _mm256_loadu_si256((const __m256i *)(b + i + 4 * k));
+            diff[k] = _mm256_sub_epi64(x, y);
+            __m256i below = _mm256_cmpgt_epi64(_mm256_xor_si256(y, bias), _mm256_xor_si256(x, bias));
+            g |= _mm256_movemask_pd(_mm256_castsi256_pd(below)) << 4 * k;
+            p |= _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(diff[k], zero))) << 4 * k;
         }
-        if (y[i / BIT_PER_DIGIT] & (1ll << (i % BIT_PER_DIGIT))) {
-            res = res.mulMod(temp, mod);
+        unsigned dec = lookahead(g, p, borrow, 16);
+        for (int k = 0; k < 4; k++) {
+            __m256i v = _mm256_add_epi64(diff[k], lane_mask_avx2(dec >> 4 * k & 15));
+            _mm256_storeu_si256((__m256i *)(r + i + 4 * k), v);
         }
     }
-    
-    // if a is negative, we need to calculate the modular inverse
-    if (a.getSign() == -1) {
-        res = mod_inverse(res, mod);
+    TYPE c = borrow;
+    for (; i < n; i++) {
+        r[i] = sub_borrow(a[i], b[i], c);
     }
-    
-    return res;
+    return c;
 }
 
-BigInteger BigInteger::pow(int n)
-{   // only for positive n
-    BigInteger res("1");
-    BigInteger temp(*this);
-    if (n == 0) return res;
-    if (n == 1) return temp;
-
-    while (n)
-    {
-        if (n%2 == 1)
-        {
-            res = res * temp;
+__attribute__((target("avx2")))
+static int cmp_n_avx2(const TYPE *a, const TYPE *b, int n) {
+    int i = n;
+    for (; i >= 4; i -= 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i - 4));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i - 4));
+        unsigned differ = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, y))) & 15;
+        if (differ) {
+            int k = i - 4 + 31 - __builtin_clz(differ);
+            return a[k] < b[k] ? -1 : 1;
         }
-        temp = temp * temp;
-        n /= 2;
     }
-    return res;
+    return cmp_n_scalar(a, b, i);
 }
 
-int BigInteger::bitLength() const
-{
-    if (is_zero()) return 0;
-    int n = size();
-    int res = (n - 1) * BIT_PER_DIGIT;
-    int i = n - 1;
-    while (i >= 0 && digits[i] == 0) {
-        i--;
+__attribute__((target("avx2")))
+static TYPE lshift_avx2(TYPE *r, const TYPE *a, int n, int s) {
+    // high to low: each store only covers limbs the lower blocks no longer read
+    TYPE out = a[n - 1] >> (BIT_PER_DIGIT - s);
+    __m128i left = _mm_cvtsi32_si128(s), right = _mm_cvtsi32_si128(BIT_PER_DIGIT - s);
+    int i = n;
+    for (; i >= 5; i -= 4) {
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(a + i - 4));
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(a + i - 5));
+        _mm256_storeu_si256((__m256i *)(r + i - 4), _mm256_or_si256(_mm256_sll_epi64(hi, left), _mm256_srl_epi64(lo, right)));
     }
-    if (i >= 0) {
-        res += msbPosition(digits[i]);
+    for (; i >= 2; i--) {
+        r[i - 1] = (a[i - 1] << s) | (a[i - 2] >> (BIT_PER_DIGIT - s));
     }
-    return res;
+    r[0] = a[0] << s;
+    return out;
 }
 
-string BigInteger::toDecimal() const
-{
-    if (is_zero()) return "0";
-    string binary = toString();
-    if (binary[0] == '-') {
-        binary = binary.substr(1);
+__attribute__((target("avx2")))
+static void rshift_avx2(TYPE *r, const TYPE *a, int n, int s) {
+    __m128i right = _mm_cvtsi32_si128(s), left = _mm_cvtsi32_si128(BIT_PER_DIGIT - s);
+    int i = 0;
+    for (; i + 5 <= n; i += 4) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(a + i + 1));
+        _mm256_storeu_si256((__m256i *)(r + i), _mm256_or_si256(_mm256_srl_epi64(lo, right), _mm256_sll_epi64(hi, left)));
+    }
+    rshift_scalar(r + i, a + i, n - i, s);
+}
+
+__attribute__((target("avx512f")))
+static TYPE add_n_avx512(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    const __m512i ones = _mm512_set1_epi64(-1);
+    unsigned carry = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x0 = _mm512_loadu_si512(a + i), x1 = _mm512_loadu_si512(a + i + 8);
+        __m512i s0 = _mm512_add_epi64(x0, _mm512_loadu_si512(b + i));
+        __m512i s1 = _mm512_add_epi64(x1, _mm512_loadu_si512(b + i + 8));
+        unsigned g = _mm512_cmplt_epu64_mask(s0, x0) | (unsigned)_mm512_cmplt_epu64_mask(s1, x1) << 8;
+        unsigned p = _mm512_cmpeq_epi64_mask(s0, ones) | (unsigned)_mm512_cmpeq_epi64_mask(s1, ones) << 8;
+        unsigned inc = lookahead(g, p, carry, 16);
+        _mm512_storeu_si512(r + i, _mm512_mask_sub_epi64(s0, (__mmask8)inc, s0, ones));
+        _mm512_storeu_si512(r + i + 8, _mm512_mask_sub_epi64(s1, (__mmask8)(inc >> 8), s1, ones));
     }
-    string decimal;
-    int n = binary.size();
+    TYPE c = carry;
+    for (; i < n; i++) {
+        r[i] = add_carry(a[i], b[i], c);
+    }
+    return c;
+}
+
+__attribute__((target("avx512f")))
+static TYPE sub_n_avx512(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    const __m512i ones = _mm512_set1_epi64(-1), zero = _mm512_setzero_si512();
+    unsigned borrow = 0;
     int i = 0;
-    while (i < n) {
-        int carry = 0;
-        for (int j = i; j < n; j++) {
-            int digit = binary[j] - '0';
-            digit += carry * 2;
-            carry = digit % 10;
-            digit /= 10;
-            binary[j] = digit + '0';
-        }
-        decimal += carry + '0';
-        while (i < n && binary[i] == '0') {
-            i++;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x0 = _mm512_loadu_si512(a + i), x1 = _mm512_loadu_si512(a + i + 8);
+        __m512i y0 = _mm512_loadu_si512(b + i), y1 = _mm512_loadu_si512(b + i + 8);
+        __m512i d0 = _mm512_sub_epi64(x0, y0), d1 = _mm512_sub_epi64(x1, y1);
+        unsigned g = _mm512_cmplt_epu64_mask(x0, y0) | (unsigned)_mm512_cmplt_epu64_mask(x1, y1) << 8;
+        unsigned p = _mm512_cmpeq_epi64_mask(d0, zero) | (unsigned)_mm512_cmpeq_epi64_mask(d1, zero) << 8;
+        unsigned dec = lookahead(g, p, borrow, 16);
+        _mm512_storeu_si512(r + i, _mm512_mask_add_epi64(d0, (__mmask8)dec, d0, ones));
+        _mm512_storeu_si512(r + i + 8, _mm512_mask_add_epi64(d1, (__mmask8)(dec >> 8), d1, ones));
+    }
+    TYPE c = borrow;
+    for (; i < n; i++) {
+        r[i] = sub_borrow(a[i], b[i], c);
+    }
+    return c;
+}
+
+__attribute__((target("avx512f")))
+static int cmp_n_avx512(const TYPE *a, const TYPE *b, int n) {
+    int i = n;
+    for (; i >= 8; i -= 8) {
+        unsigned differ = _mm512_cmpneq_epu64_mask(_mm512_loadu_si512(a + i - 8), _mm512_loadu_si512(b + i - 8));
+        if (differ) {
+            int k = i - 8 + 31 - __builtin_clz(differ);
+            return a[k] < b[k] ? -1 : 1;
         }
     }
-    reverse(decimal.begin(), decimal.end());
-    if (sign == -1) {
-        decimal = '-' + decimal;
+    return cmp_n_scalar(a, b, i);
+}
+
+__attribute__((target("avx512f")))
+static TYPE lshift_avx512(TYPE *r, const TYPE *a, int n, int s) {
+    TYPE out = a[n - 1] >> (BIT_PER_DIGIT - s);
+    // the zero-masked shifts avoid the undefined pass-through operand that
+    // the plain forms hand to the builtin, which gcc 12 reports as uninitialized
+    const __mmask8 all = 0xFF;
+    __m128i left = _mm_cvtsi64_si128(s), right = _mm_cvtsi64_si128(BIT_PER_DIGIT - s);
+    int i = n;
+    for (; i >= 9; i -= 8) {
+        __m512i hi = _mm512_loadu_si512(a + i - 8), lo = _mm512_loadu_si512(a + i - 9);
+        _mm512_storeu_si512(r + i - 8, _mm512_or_si512(_mm512_maskz_sll_epi64(all, hi, left), _mm512_maskz_srl_epi64(all, lo, right)));
+    }
+    for (; i >= 2; i--) {
+        r[i - 1] = (a[i - 1] << s) | (a[i - 2] >> (BIT_PER_DIGIT - s));
     }
-    return decimal;
+    r[0] = a[0] << s;
+    return out;
 }
 
-BigInteger BigInteger::operator>>(int i) { 
-    if (i < 0) {
-        throw "Shift right must be positive";
+__attribute__((target("avx512f")))
+static void rshift_avx512(TYPE *r, const TYPE *a, int n, int s) {
+    const __mmask8 all = 0xFF;
+    __m128i right = _mm_cvtsi64_si128(s), left = _mm_cvtsi64_si128(BIT_PER_DIGIT - s);
+    int i = 0;
+    for (; i + 9 <= n; i += 8) {
+        __m512i lo = _mm512_loadu_si512(a + i), hi = _mm512_loadu_si512(a + i + 1);
+        _mm512_storeu_si512(r + i, _mm512_or_si512(_mm512_maskz_srl_epi64(all, lo, right), _mm512_maskz_sll_epi64(all, hi, left)));
+    }
+    rshift_scalar(r + i, a + i, n - i, s);
+}
+#endif
+
+struct LimbKernels {
+    TYPE (*add_n)(TYPE *r, const TYPE *a, const TYPE *b, int n);
+    TYPE (*sub_n)(TYPE *r, const TYPE *a, const TYPE *b, int n);
+    int (*cmp_n)(const TYPE *a, const TYPE *b, int n);
+    TYPE (*lshift)(TYPE *r, const TYPE *a, int n, int s);
+    void (*rshift)(TYPE *r, const TYPE *a, int n, int s);
+};
+
+static LimbKernels select_limb_kernels() {
+#ifdef BIGINT_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {add_n_avx512, sub_n_avx512, cmp_n_avx512, lshift_avx512, rshift_avx512};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {add_n_avx2, sub_n_avx2, cmp_n_avx2, lshift_avx2, rshift_avx2};
+    }
+#endif
+    return {add_n_scalar, sub_n_scalar, cmp_n_scalar, lshift_scalar, rshift_scalar};
+}
+
+// chosen on first use rather than at static initialization, so static BigIntegers in other
+// translation units can already do arithmetic
+static const LimbKernels &limb_kernels() {
+    static const LimbKernels kernels = select_limb_kernels();
+    return kernels;
+}
+
+// below this many limbs the scalar loop wins over the call and the vector setup
+static const int SIMD_THRESHOLD = 16;
+
+// r[0..n) = a[0..n) + b[0..n), returns the carry out
+static TYPE add_n(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    if (n >= SIMD_THRESHOLD) return limb_kernels().add_n(r, a, b, n);
+    return add_n_scalar(r, a, b, n);
+}
+
+// r[0..n) = a[0..n) - b[0..n), returns the borrow out
+static TYPE sub_n(TYPE *r, const TYPE *a, const TYPE *b, int n) {
+    if (n >= SIMD_THRESHOLD) return limb_kernels().sub_n(r, a, b, n);
+    return sub_n_scalar(r, a, b, n);
+}
+
+// sign of a[0..n) - b[0..n)
+static int cmp_n(const TYPE *a, const TYPE *b, int n) {
+    if (n >= SIMD_THRESHOLD) return limb_kernels().cmp_n(a, b, n);
+    return cmp_n_scalar(a, b, n);
+}
+
+// r[0..n) = a[0..n) + b[0..m) with n >= m, returns the carry out
+static TYPE add_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m) {
+    TYPE carry = add_n(r, a, b, m);
+    for (int i = m; i < n; i++) {
+        r[i] = add_carry(a[i], 0, carry);
+    }
+    return carry;
+}
+
+// r[0..n) = a[0..n) - b[0..m) with n >= m, returns the borrow out
+static TYPE sub_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m) {
+    TYPE borrow = sub_n(r, a, b, m);
+    for (int i = m; i < n; i++) {
+        r[i] = sub_borrow(a[i], 0, borrow);
+    }
+    return borrow;
+}
+
+// r[0..rn) += a[0..n) with rn >= n, returns the carry out of r
+static TYPE add_into(TYPE *r, int rn, const TYPE *a, int n) {
+    TYPE carry = add_n(r, r, a, n);
+    for (int i = n; carry && i < rn; i++) {
+        r[i] = add_carry(r[i], 0, carry);
+    }
+    return carry;
+}
+
+// r[0..rn) -= a[0..n) with rn >= n, returns the borrow out of r
+static TYPE sub_from(TYPE *r, int rn, const TYPE *a, int n) {
+    TYPE borrow = sub_n(r, r, a, n);
+    for (int i = n; borrow && i < rn; i++) {
+        r[i] = sub_borrow(r[i], 0, borrow);
+    }
+    return borrow;
+}
+
+static int cmp_limbs(const TYPE *a, int n, const TYPE *b, int m) {
+    for (; n > m; n--) {
+        if (a[n - 1]) return 1;
+    }
+    for (; m > n; m--) {
+        if (b[m - 1]) return -1;
+    }
+    return cmp_n(a, b, n);
+}
+
+// r[0..n) = |a[0..n) - b[0..m)| with n >= m, returns -1 if a < b and 1 otherwise
+static int abs_sub(TYPE *r, const TYPE *a, int n, const TYPE *b, int m) {
+    if (cmp_limbs(a, n, b, m) >= 0) {
+        sub_limbs(r, a, n, b, m);
+        return 1;
+    }
+    // a < b < BASE^m, so the limbs of a above m are all zero
+    sub_n(r, b, a, m);
+    fill(r + m, r + n, 0);
+    return -1;
+}
+
+// r[0..n) = a[0..n) << 1, returns the bit shifted out
+static TYPE lshift1(TYPE *r, const TYPE *a, int n) {
+    TYPE carry = 0;
+    for (int i = 0; i < n; i++) {
+        TYPE v = a[i];
+        r[i] = (v << 1) | carry;
+        carry = v >> (BIT_PER_DIGIT - 1);
+    }
+    return carry;
+}
+
+// r[0..n) = a[0..n) >> 1
+static void rshift1(TYPE *r, const TYPE *a, int n) {
+    for (int i = 0; i < n; i++) {
+        TYPE high = i + 1 < n ? (a[i + 1] & 1) : 0;
+        r[i] = (a[i] >> 1) | (high << (BIT_PER_DIGIT - 1));
+    }
+}
+
+// r[0..n) = a[0..n) / 3, the division must be exact: low limb first, each quotient limb is
+// the running difference times 3^-1 mod 2^64, and the high half of 3 q is carried up
+static void divexact_by3(TYPE *r, const TYPE *a, int n) {
+    const ull INV3 = 0xaaaaaaaaaaaaaaabull;
+    ull carry = 0;
+    for (int i = 0; i < n; i++) {
+        ull x = a[i];
+        ull q = (x - carry) * INV3;
+        ull borrow = x < carry;
+        r[i] = q;
+        carry = (ull)(((u128)q * 3) >> BIT_PER_DIGIT) + borrow;
+    }
+}
+
+// r[0..n+m) = a[0..n) * b[0..m), schoolbook with one 64x64 -> 128-bit product per limb pair
+static void mul_basecase(TYPE *r, const TYPE *a, int n, const TYPE *b, int m) {
+    fill(r, r + n + m, 0);
+    // no shortcut for zero limbs, so the running time depends only on n and m
+    for (int i = 0; i < n; i++) {
+        u128 ai = a[i];
+        ull carry = 0;
+        for (int j = 0; j < m; j++) {
+            // (2^64 - 1)^2 + 2 (2^64 - 1) = 2^128 - 1, so the sum below never overflows
+            u128 cur = ai * b[j] + r[i + j] + carry;
+            r[i + j] = (TYPE)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        r[i + m] = (TYPE)carry;
+    }
+}
+
+// r[0..2n) = a[0..n)^2, each cross product is computed once and doubled
+static void sqr_basecase(TYPE *r, const TYPE *a, int n) {
+    fill(r, r + 2 * n, 0);
+    // no shortcut for zero limbs, so the running time depends only on n and m
+    for (int i = 0; i < n; i++) {
+        u128 ai = a[i];
+        ull carry = 0;
+        for (int j = i + 1; j < n; j++) {
+            u128 cur = ai * a[j] + r[i + j] + carry;
+            r[i + j] = (TYPE)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        r[i + n] = (TYPE)carry;
+    }
+    lshift1(r, r, 2 * n);
+    ull carry = 0;
+    for (int i = 0; i < n; i++) {
+        u128 sq = (u128)a[i] * a[i];
+        u128 lo = (u128)r[2 * i] + (ull)sq + carry;
+        r[2 * i] = (TYPE)lo;
+        u128 hi = (u128)r[2 * i + 1] + (ull)(sq >> BIT_PER_DIGIT) + (ull)(lo >> BIT_PER_DIGIT);
+        r[2 * i + 1] = (TYPE)hi;
+        carry = (ull)(hi >> BIT_PER_DIGIT);
+    }
+}
+
+// scratch needed by mul_limbs/sqr_limbs for operands of at most n limbs
+static int mul_scratch_size(int n) {
+    return 16 * n + 1024;
+}
+
+static void mul_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m, TYPE *ws);
+
+static void sqr_limbs(TYPE *r, const TYPE *a, int n, TYPE *ws);
+
+// Karatsuba for h < m <= n, h = ceil(n / 2):
+// a*b = z0 + (z0 + z2 - (a0 - a1)(b0 - b1)) * BASE^h + z2 * BASE^2h
+static void karatsuba_mul(TYPE *r, const TYPE *a, int n, const TYPE *b, int m, TYPE *ws) {
+    int h = (n + 1) / 2;
+    TYPE *da = ws, *db = da + h, *d = db + h, *mid = d + 2 * h, *next = mid + 2 * h + 1;
+
+    int sign = abs_sub(da, a, h, a + h, n - h) * abs_sub(db, b, h, b + h, m - h);
+
+    mul_limbs(r, a, h, b, h, next);
+    mul_limbs(r + 2 * h, a + h, n - h, b + h, m - h, next);
+    mul_limbs(d, da, h, db, h, next);
+
+    mid[2 * h] = add_limbs(mid, r, 2 * h, r + 2 * h, n + m - 2 * h);
+    if (sign > 0) {
+        sub_from(mid, 2 * h + 1, d, 2 * h);
+    } else {
+        add_into(mid, 2 * h + 1, d, 2 * h);
+    }
+    add_into(r + h, n + m - h, mid, min(2 * h + 1, n + m - h));
+}
+
+static void karatsuba_sqr(TYPE *r, const TYPE *a, int n, TYPE *ws) {
+    int h = (n + 1) / 2;
+    TYPE *da = ws, *d = da + h, *mid = d + 2 * h, *next = mid + 2 * h + 1;
+
+    abs_sub(da, a, h, a + h, n - h);
+
+    sqr_limbs(r, a, h, next);
+    sqr_limbs(r + 2 * h, a + h, n - h, next);
+    sqr_limbs(d, da, h, next);
+
+    mid[2 * h] = add_limbs(mid, r, 2 * h, r + 2 * h, 2 * n - 2 * h);
+    sub_from(mid, 2 * h + 1, d, 2 * h);
+    add_into(r + h, 2 * n - h, mid, min(2 * h + 1, 2 * n - h));
+}
+
+// evaluates x0 + x1*t + x2*t^2 (x0, x1 of k limbs, x2 of s limbs) at t = 1, -1 and 2,
+// each into k + 1 limbs; returns the sign of the value at -1
+static int toom3_eval(TYPE *v1, TYPE *vm1, TYPE *v2, const TYPE *x, int k, int s) {
+    const TYPE *x0 = x, *x1 = x + k, *x2 = x + 2 * k;
+
+    v1[k] = add_limbs(v1, x0, k, x2, s);
+    int sign = abs_sub(vm1, v1, k + 1, x1, k);
+    add_into(v1, k + 1, x1, k);
+
+    copy(x2, x2 + s, v2);
+    fill(v2 + s, v2 + k + 1, 0);
+    lshift1(v2, v2, k + 1);
+    add_into(v2, k + 1, x1, k);
+    lshift1(v2, v2, k + 1);
+    add_into(v2, k + 1, x0, k);
+    return sign;
+}
+
+// Toom-Cook 3-way over the points 0, 1, -1, 2 and infinity. The interpolation
+// order below keeps every intermediate value non-negative:
+//   r1 + r3  = (v1 - vm1) / 2
+//   r2       = (v1 + vm1) / 2 - v0 - vinf
+//   r3       = ((v2 - vm1) / 3 - (r1 + r3) - r2 - vinf) / 2 - 2 * vinf
+//   r1       = (r1 + r3) - r3
+static void toom3_interpolate(TYPE *r, int rn, int k, int sign_m1,
+                              TYPE *v1, TYPE *vm1, TYPE *v2, TYPE *ws) {
+    int len = 2 * k + 3;
+    const TYPE *vinf = r + 4 * k;
+    int ninf = rn - 4 * k;
+    TYPE *t1 = ws, *t2 = t1 + len, *t3 = t2 + len;
+
+    // v1, vm1 and v2 hold 2k + 2 limbs, widen them by one for the carries
+    v1[len - 1] = vm1[len - 1] = v2[len - 1] = 0;
+    if (sign_m1 > 0) {
+        sub_limbs(t1, v1, len, vm1, len);
+        add_n(t2, v1, vm1, len);
+        sub_limbs(t3, v2, len, vm1, len);
+    } else {
+        add_n(t1, v1, vm1, len);
+        sub_limbs(t2, v1, len, vm1, len);
+        add_n(t3, v2, vm1, len);
+    }
+    rshift1(t1, t1, len);
+    rshift1(t2, t2, len);
+    sub_from(t2, len, r, 2 * k);
+    sub_from(t2, len, vinf, ninf);
+
+    divexact_by3(t3, t3, len);
+    sub_from(t3, len, t1, len);
+    sub_from(t3, len, t2, len);
+    sub_from(t3, len, vinf, ninf);
+    rshift1(t3, t3, len);
+    sub_from(t3, len, vinf, ninf);
+    sub_from(t3, len, vinf, ninf);
+
+    sub_from(t1, len, t3, len);
+
+    fill(r + 2 * k, r + 4 * k, 0);
+    add_into(r + k, rn - k, t1, min(len, rn - k));
+    add_into(r + 2 * k, rn - 2 * k, t2, min(len, rn - 2 * k));
+    add_into(r + 3 * k, rn - 3 * k, t3, min(len, rn - 3 * k));
+}
+
+// Toom-3 for n >= m > 2k, k = ceil(n / 3)
+static void toom3_mul(TYPE *r, const TYPE *a, int n, const TYPE *b, int m, TYPE *ws) {
+    int k = (n + 2) / 3;
+    int s = n - 2 * k, t = m - 2 * k;
+    int e = k + 1;
+    TYPE *as1 = ws, *asm1 = as1 + e, *as2 = asm1 + e;
+    TYPE *bs1 = as2 + e, *bsm1 = bs1 + e, *bs2 = bsm1 + e;
+    TYPE *v1 = bs2 + e, *vm1 = v1 + 2 * e + 1, *v2 = vm1 + 2 * e + 1;
+    TYPE *next = v2 + 2 * e + 1;
+
+    int sign_m1 = toom3_eval(as1, asm1, as2, a, k, s) * toom3_eval(bs1, bsm1, bs2, b, k, t);
+
+    mul_limbs(v1, as1, e, bs1, e, next);
+    mul_limbs(vm1, asm1, e, bsm1, e, next);
+    mul_limbs(v2, as2, e, bs2, e, next);
+    mul_limbs(r, a, k, b, k, next);
+    if (s >= t) {
+        mul_limbs(r + 4 * k, a + 2 * k, s, b + 2 * k, t, next);
+    } else {
+        mul_limbs(r + 4 * k, b + 2 * k, t, a + 2 * k, s, next);
+    }
+
+    toom3_interpolate(r, n + m, k, sign_m1, v1, vm1, v2, next);
+}
+
+static void toom3_sqr(TYPE *r, const TYPE *a, int n, TYPE *ws) {
+    int k = (n + 2) / 3;
+    int s = n - 2 * k;
+    int e = k + 1;
+    TYPE *as1 = ws, *asm1 = as1 + e, *as2 = asm1 + e;
+    TYPE *v1 = as2 + e, *vm1 = v1 + 2 * e + 1, *v2 = vm1 + 2 * e + 1;
+    TYPE *next = v2 + 2 * e + 1;
+
+    toom3_eval(as1, asm1, as2, a, k, s);
+
+    sqr_limbs(v1, as1, e, next);
+    sqr_limbs(vm1, asm1, e, next);
+    sqr_limbs(v2, as2, e, next);
+    sqr_limbs(r, a, k, next);
+    sqr_limbs(r + 4 * k, a + 2 * k, s, next);
+
+    toom3_interpolate(r, 2 * n, k, 1, v1, vm1, v2, next);
+}
+
+// ---- number-theoretic transform ----
+// Products are convolved modulo three 62-bit primes p = c * 2^42 + 1 and recombined with
+// the CRT. Their product exceeds 2^185, which bounds every convolution coefficient
+// (< length * BASE^2) for any transform length the primes support.
+
+struct NttPrime {
+    ull p;
+    ull g;    // primitive root
+    ull pinv; // -p^-1 mod 2^64
+    ull r2;   // 2^128 mod p, converts into Montgomery form
+};
+
+static NttPrime make_ntt_prime(ull p, ull g) {
+    ull inv = p; // Newton iteration, each step doubles the number of correct low bits
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - p * inv;
+    }
+    u128 r = ((u128)0 - 1) % p + 1;
+    return NttPrime{p, g, (ull)0 - inv, (ull)(r % p)};
+}
+
+static const NttPrime NTT_PRIMES[3] = {
+    make_ntt_prime(4611615649683210241ull, 11),
+    make_ntt_prime(4611549678985543681ull, 19),
+    make_ntt_prime(4611496902427410433ull, 5),
+};
+
+// a * b * 2^-64 mod p for a, b < p
+static ull ntt_mul(ull a, ull b, const NttPrime &q) {
+    u128 t = (u128)a * b;
+    ull m = (ull)t * q.pinv;
+    ull u = (ull)((t + (u128)m * q.p) >> 64);
+    return u >= q.p ? u - q.p : u;
+}
+
+static ull ntt_add(ull a, ull b, const NttPrime &q) {
+    ull s = a + b;
+    return s >= q.p ? s - q.p : s;
+}
+
+static ull ntt_sub(ull a, ull b, const NttPrime &q) {
+    return a >= b ? a - b : a + q.p - b;
+}
+
+static ull ntt_to_mont(ull a, const NttPrime &q) {
+    return ntt_mul(a, q.r2, q);
+}
+
+// x^e mod p with x and the result in Montgomery form
+static ull ntt_pow(ull x, ull e, const NttPrime &q) {
+    ull res = ntt_to_mont(1, q);
+    while (e) {
+        if (e & 1) res = ntt_mul(res, x, q);
+        x = ntt_mul(x, x, q);
+        e >>= 1;
+    }
+    return res;
+}
+
+// Twiddle factors as plain residues w together with Shoup's floor(w * 2^64 / p), which turns
+// a product by w into one high and two low multiplications. The stage of length len reads
+// w_len^j for j < len / 2 from index len / 2 + j, so the table for a size n also covers
+// every smaller size.
+struct NttTables {
+    vector<ull> roots, roots_shoup, iroots, iroots_shoup;
+};
+
+static mutex ntt_mutex;
+static shared_ptr<const NttTables> ntt_cache[3];
+
+static shared_ptr<const NttTables> ntt_tables(int prime, int n) {
+    lock_guard<mutex> lock(ntt_mutex);
+    shared_ptr<const NttTables> &cached = ntt_cache[prime];
+    if (cached && (int)cached->roots.size() >= n) {
+        return cached;
+    }
+
+    const NttPrime &q = NTT_PRIMES[prime];
+    auto tables = make_shared<NttTables>();
+    tables->roots.resize(n);
+    tables->roots_shoup.resize(n);
+    tables->iroots.resize(n);
+    tables->iroots_shoup.resize(n);
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        ull w = ntt_pow(ntt_to_mont(q.g, q), (q.p - 1) / len, q);
+        ull iw = ntt_pow(w, q.p - 2, q);
+        ull x = ntt_to_mont(1, q), ix = x;
+        for (int j = 0; j < half; j++) {
+            // ntt_mul by 1 takes the power out of Montgomery form
+            ull r = ntt_mul(x, 1, q), ir = ntt_mul(ix, 1, q);
+            tables->roots[half + j] = r;
+            tables->roots_shoup[half + j] = (ull)(((u128)r << 64) / q.p);
+            tables->iroots[half + j] = ir;
+            tables->iroots_shoup[half + j] = (ull)(((u128)ir << 64) / q.p);
+            x = ntt_mul(x, w, q);
+            ix = ntt_mul(ix, iw, q);
+        }
+    }
+    cached = tables;
+    return cached;
+}
+
+// x * w mod p in [0, 2p) for any 64-bit x
+static ull ntt_mul_shoup(ull x, ull w, ull w_shoup, ull p) {
+    ull quot = (ull)(((u128)x * w_shoup) >> 64);
+    return x * w - quot * p;
+}
+
+// Decimation in frequency, natural order in, bit-reversed order out. The butterflies are
+// lazy (Harvey): values stay in [0, 2p), which fits since 4p < 2^64.
+static void ntt_forward(ull *a, int n, const NttTables &t, const NttPrime &q) {
+    ull p = q.p, p2 = 2 * q.p;
+    for (int len = n; len >= 2; len >>= 1) {
+        int half = len / 2;
+        const ull *w = t.roots.data() + half, *ws = t.roots_shoup.data() + half;
+        for (int i = 0; i < n; i += len) {
+            ull *x = a + i, *y = a + i + half;
+            for (int j = 0; j < half; j++) {
+                ull u = x[j], v = y[j];
+                ull sum = u + v;
+                x[j] = sum >= p2 ? sum - p2 : sum;
+                y[j] = ntt_mul_shoup(u - v + p2, w[j], ws[j], p);
+            }
+        }
+    }
+}
+
+// Decimation in time, bit-reversed order in, natural order out in [0, 2p), not scaled by 1/n
+static void ntt_inverse(ull *a, int n, const NttTables &t, const NttPrime &q) {
+    ull p = q.p, p2 = 2 * q.p;
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        const ull *w = t.iroots.data() + half, *ws = t.iroots_shoup.data() + half;
+        for (int i = 0; i < n; i += len) {
+            ull *x = a + i, *y = a + i + half;
+            for (int j = 0; j < half; j++) {
+                ull u = x[j], v = ntt_mul_shoup(y[j], w[j], ws[j], p);
+                ull sum = u + v, diff = u - v + p2;
+                x[j] = sum >= p2 ? sum - p2 : sum;
+                y[j] = diff >= p2 ? diff - p2 : diff;
+            }
+        }
+    }
+}
+
+static void ntt_load(ull *f, int len, const TYPE *a, int n, const NttPrime &q) {
+    for (int i = 0; i < n; i++) {
+        ull x = (ull)a[i];
+        f[i] = x >= q.p ? x % q.p : x;
+    }
+    fill(f + n, f + len, 0);
+}
+
+// res = a * b (or a^2 when b is null) modulo one prime, in natural order and scaled
+// so that the values are plain residues
+static void ntt_convolve(ull *res, ull *temp, int len, int prime,
+                         const TYPE *a, int n, const TYPE *b, int m) {
+    const NttPrime &q = NTT_PRIMES[prime];
+    shared_ptr<const NttTables> tables = ntt_tables(prime, len);
+
+    ntt_load(res, len, a, n, q);
+    ntt_forward(res, len, *tables, q);
+    if (b) {
+        ntt_load(temp, len, b, m, q);
+        ntt_forward(temp, len, *tables, q);
+    } else {
+        temp = res;
+    }
+    // the Montgomery products carry a 2^-64 factor, which is cancelled below
+    for (int i = 0; i < len; i++) {
+        ull x = res[i] >= q.p ? res[i] - q.p : res[i];
+        ull y = temp[i] >= q.p ? temp[i] - q.p : temp[i];
+        res[i] = ntt_mul(x, y, q);
+    }
+    ntt_inverse(res, len, *tables, q);
+
+    // scale by 2^64 / len, which in Montgomery form is 2^128 / len
+    ull scale = ntt_to_mont(ntt_to_mont(1, q), q);
+    scale = ntt_mul(scale, ntt_pow(ntt_to_mont(len, q), q.p - 2, q), q);
+    for (int i = 0; i < len; i++) {
+        ull x = res[i] >= q.p ? res[i] - q.p : res[i];
+        res[i] = ntt_mul(x, scale, q);
+    }
+}
+
+// r[0..n+m) = a[0..n) * b[0..m), or a^2 into r[0..2n) when b is null
+static void ntt_mul_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m) {
+    if (!b) m = n;
+    if (n + m - 1 > (1 << 30)) {
+        throw "Operands too large for NTT multiplication";
+    }
+    int len = 1;
+    while (len < n + m - 1) len <<= 1;
+
+    LimbVector res0(len), res1(len), res2(len), temp(b ? len : 0);
+    ntt_convolve(res0.data(), temp.data(), len, 0, a, n, b, m);
+    ntt_convolve(res1.data(), temp.data(), len, 1, a, n, b, m);
+    ntt_convolve(res2.data(), temp.data(), len, 2, a, n, b, m);
+
+    // Garner: c = x0 + p0 * y1 + p0 * p1 * y2, with the constants in Montgomery form
+    const NttPrime &q0 = NTT_PRIMES[0], &q1 = NTT_PRIMES[1], &q2 = NTT_PRIMES[2];
+    static const ull inv_p0 = ntt_pow(ntt_to_mont(q0.p % q1.p, q1), q1.p - 2, q1);
+    static const ull p0_mod_p2 = ntt_to_mont(q0.p % q2.p, q2);
+    static const ull inv_p0p1 = ntt_pow(ntt_to_mont((ull)((u128)q0.p * q1.p % q2.p), q2), q2.p - 2, q2);
+    const u128 p0p1 = (u128)q0.p * q1.p;
+
+    // acc holds the pending 192-bit carry as three 64-bit words
+    ull acc0 = 0, acc1 = 0, acc2 = 0;
+    for (int i = 0; i < n + m; i++) {
+        if (i < n + m - 1) {
+            ull x0 = res0[i], x1 = res1[i], x2 = res2[i];
+            // p0 > p1 > p2 and p0 < 2 * p2, so one conditional subtraction reduces across primes
+            ull y1 = ntt_mul(ntt_sub(x1, x0 >= q1.p ? x0 - q1.p : x0, q1), inv_p0, q1);
+            ull x01_mod_p2 = ntt_add(x0 >= q2.p ? x0 - q2.p : x0,
+                                     ntt_mul(y1 >= q2.p ? y1 - q2.p : y1, p0_mod_p2, q2), q2);
+            ull y2 = ntt_mul(ntt_sub(x2, x01_mod_p2, q2), inv_p0p1, q2);
+
+            u128 x01 = (u128)x0 + (u128)q0.p * y1;
+            u128 lo = (u128)(ull)p0p1 * y2;
+            u128 hi = (u128)(ull)(p0p1 >> 64) * y2 + (ull)(lo >> 64);
+            ull c0 = (ull)lo, c1 = (ull)hi, c2 = (ull)(hi >> 64);
+            u128 s = (u128)c0 + (ull)x01;
+            c0 = (ull)s;
+            s = (u128)c1 + (ull)(x01 >> 64) + (ull)(s >> 64);
+            c1 = (ull)s;
+            c2 += (ull)(s >> 64);
+
+            s = (u128)acc0 + c0;
+            acc0 = (ull)s;
+            s = (u128)acc1 + c1 + (ull)(s >> 64);
+            acc1 = (ull)s;
+            acc2 += c2 + (ull)(s >> 64);
+        }
+        // one limb is exactly one word of the accumulator
+        r[i] = acc0;
+        acc0 = acc1;
+        acc1 = acc2;
+        acc2 = 0;
+    }
+}
+
+// r[0..n+m) = a[0..n) * b[0..m), n >= m >= 1, picks the algorithm from mul_thresholds
+static void mul_limbs(TYPE *r, const TYPE *a, int n, const TYPE *b, int m, TYPE *ws) {
+    if (m >= mul_thresholds.ntt) {
+        ntt_mul_limbs(r, a, n, b, m);
+        return;
+    }
+    if (m < mul_thresholds.karatsuba) {
+        mul_basecase(r, a, n, b, m);
+        return;
+    }
+    if (m <= (n + 1) / 2) {
+        // unbalanced: multiply b by m-limb slices of a
+        mul_limbs(r, a, m, b, m, ws);
+        fill(r + 2 * m, r + n + m, 0);
+        TYPE *temp = ws, *next = ws + 2 * m;
+        for (int i = m; i < n; i += m) {
+            int len = min(m, n - i);
+            if (len >= m) {
+                mul_limbs(temp, a + i, len, b, m, next);
+            } else {
+                mul_limbs(temp, b, m, a + i, len, next);
+            }
+            add_into(r + i, n + m - i, temp, len + m);
+        }
+        return;
+    }
+    if (m >= mul_thresholds.toom3 && m > 2 * ((n + 2) / 3)) {
+        toom3_mul(r, a, n, b, m, ws);
+    } else {
+        karatsuba_mul(r, a, n, b, m, ws);
+    }
+}
+
+// r[0..2n) = a[0..n)^2
+static void sqr_limbs(TYPE *r, const TYPE *a, int n, TYPE *ws) {
+    if (n >= mul_thresholds.ntt) {
+        ntt_mul_limbs(r, a, n, nullptr, n);
+    } else if (n < mul_thresholds.karatsuba) {
+        sqr_basecase(r, a, n);
+    } else if (n >= mul_thresholds.toom3) {
+        toom3_sqr(r, a, n, ws);
+    } else {
+        karatsuba_sqr(r, a, n, ws);
+    }
+}
+
+// r[0..n) = a[0..n) << s for 0 <= s < BIT_PER_DIGIT, returns the bits shifted out; r may alias a
+static TYPE lshift_limbs(TYPE *r, const TYPE *a, int n, int s) {
+    if (s == 0) {
+        copy(a, a + n, r);
+        return 0;
+    }
+    if (n >= SIMD_THRESHOLD) return limb_kernels().lshift(r, a, n, s);
+    return lshift_scalar(r, a, n, s);
+}
+
+// r[0..n) = a[0..n) >> s for 0 <= s < BIT_PER_DIGIT; r may alias a or sit below it
+static void rshift_limbs(TYPE *r, const TYPE *a, int n, int s) {
+    if (s == 0) {
+        copy(a, a + n, r);
+    } else if (n >= SIMD_THRESHOLD) {
+        limb_kernels().rshift(r, a, n, s);
+    } else if (n > 0) {
+        rshift_scalar(r, a, n, s);
+    }
+}
+
+// q[0..n-m] = a / b and r[0..m) = a % b for a[0..n), b[0..m) with n >= m and b[m-1] != 0,
+// either output may be null. Knuth, TAOCP vol. 2, 4.3.1, Algorithm D: b is normalized so
+// its top limb has the high bit set, then every quotient limb is estimated from the top
+// two limbs of the running remainder and corrected at most twice.
+static void divmod_limbs(TYPE *q, TYPE *r, const TYPE *a, int n, const TYPE *b, int m) {
+    if (m == 1) {
+        ull d = b[0];
+        ull rem = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            u128 cur = ((u128)rem << BIT_PER_DIGIT) | (ull)a[i];
+            if (q) q[i] = (TYPE)(cur / d);
+            rem = (ull)(cur % d);
+        }
+        if (r) r[0] = (TYPE)rem;
+        return;
+    }
+
+    int s = BIT_PER_DIGIT - msbPosition(b[m - 1]);
+    LimbVector u(n + 1), v(m);
+    lshift_limbs(v.data(), b, m, s);
+    u[n] = lshift_limbs(u.data(), a, n, s);
+    ull v1 = v[m - 1], v2 = v[m - 2];
+
+    for (int j = n - m; j >= 0; j--) {
+        u128 num = ((u128)(ull)u[j + m] << BIT_PER_DIGIT) | (ull)u[j + m - 1];
+        u128 qhat = num / v1;
+        u128 rhat = num % v1;
+        // the quotient limb is below BASE, which bounds qhat * v2 below 2^128
+        if (qhat >= BASE) {
+            qhat = BASE - 1;
+            rhat = num - qhat * v1;
+        }
+        while (rhat < BASE && qhat * v2 > ((rhat << BIT_PER_DIGIT) | (ull)u[j + m - 2])) {
+            qhat--;
+            rhat += v1;
+        }
+
+        // u[j..j+m] -= qhat * v
+        ull qd = (ull)qhat;
+        ull carry = 0;
+        TYPE borrow = 0;
+        for (int i = 0; i < m; i++) {
+            u128 prod = (u128)qd * (ull)v[i] + carry;
+            carry = (ull)(prod >> BIT_PER_DIGIT);
+            u[j + i] = sub_borrow(u[j + i], (TYPE)prod, borrow);
+        }
+        TYPE top = sub_borrow(u[j + m], carry, borrow);
+
+        if (borrow) {
+            // qhat was one too large, add v back; the carry out cancels the borrow
+            qd--;
+            top += add_n(u.data() + j, u.data() + j, v.data(), m);
+        }
+        u[j + m] = top;
+        if (q) q[j] = (TYPE)qd;
+    }
+
+    if (r) rshift_limbs(r, u.data(), m, s);
+}
+
+BigInteger BigInteger::operator*(const BigInteger &a) const {
+    BigInteger res;
+    if (digits.empty() || a.getLimbs().empty()) {
+        return res;
+    }
+
+    int n = size();
+    int m = a.size();
+    if (n < m) return a * *this;
+
+    res.digits.resize(n + m);
+    LimbVector ws(m < mul_thresholds.karatsuba ? 0 : mul_scratch_size(n));
+    mul_limbs(res.digits.data(), digits.data(), n, a.digits.data(), m, ws.data());
+    res.sign = sign * a.sign;
+    res.trim();
+    return res;
+}
+
+BigInteger BigInteger::square() const {
+    BigInteger res;
+    if (digits.empty()) {
+        return res;
+    }
+
+    int n = size();
+    res.digits.resize(2 * n);
+    LimbVector ws(n < mul_thresholds.karatsuba ? 0 : mul_scratch_size(n));
+    sqr_limbs(res.digits.data(), digits.data(), n, ws.data());
+    res.trim();
+    return res;
+}
+
+BigInteger BigInteger::mulNTT(const BigInteger &a) const {
+    BigInteger res;
+    if (digits.empty() || a.digits.empty()) {
+        return res;
+    }
+
+    res.digits.resize(size() + a.size());
+    ntt_mul_limbs(res.digits.data(), digits.data(), size(), a.digits.data(), a.size());
+    res.sign = sign * a.sign;
+    res.trim();
+    return res;
+}
+
+string BigInteger::toString() const {
+    if (is_zero()) return "0";
+    int bits = bitLength();
+    int offset = sign == -1;
+    string binary(offset + bits, '0');
+    if (offset) {
+        binary[0] = '-';
+    }
+    for (int i = 0; i < bits; i++) {
+        if (digits[i / BIT_PER_DIGIT] >> (i % BIT_PER_DIGIT) & 1) {
+            binary[offset + bits - 1 - i] = '1';
+        }
+    }
+    return binary;
+}
+
+bool BigInteger::is_zero() const {
+    return digits.empty() || (digits.size() == 1 && digits[0] == 0);
+}
+
+BigInteger BigInteger::addMod(const BigInteger &other, const BigInteger &mod) const {
+    if (this->is_zero()) {
+        return other.mod(mod);
+    }
+    if (other.is_zero()) {
+        return this->mod(mod);
+    }
+    BigInteger temp(*this);
+    BigInteger res = temp + other;
+    return res.mod(mod);
+}
+
+BigInteger BigInteger::mod(const BigInteger &mod) const {
+    return *this % mod;
+}
+
+BigInteger BigInteger::mulMod(const BigInteger &other, const BigInteger &mod) const {
+    BigInteger res;
+    if (this->is_zero() || other.is_zero())
+        return res;
+    return (*this * other).mod(mod);
+}
+
+BigInteger BigInteger::powMod(const BigInteger &a, const BigInteger &mod) const {
+    BigInteger res(1ll);
+    if (a.is_zero())
+        return res;
+    // res predates the scope, so assigning to it copies the result out of the arena
+    ScratchScope scratch;
+    BigInteger abs_mod = mod.abs();
+
+    if (!abs_mod.is_even() && abs_mod > res) {
+        res = MontgomeryContext(abs_mod).powMod(*this, a.abs());
+    } else {
+        res = BarrettContext(abs_mod).powMod(*this, a.abs());
+    }
+    
+    // if a is negative, we need to calculate the modular inverse
+    if (a.getSign() == -1) {
+        res = mod_inverse(res, mod);
+    }
+    
+    return res;
+}
+
+BigInteger BigInteger::powModConstTime(const BigInteger &a, const BigInteger &mod) const {
+    BigInteger abs_mod = mod.abs();
+    if (abs_mod.is_even() || abs_mod <= BigInteger(1ll)) {
+        throw "Constant-time powMod needs an odd modulus greater than 1";
+    }
+    if (a.getSign() < 0) {
+        throw "Constant-time powMod needs a non-negative exponent";
+    }
+    return MontgomeryContext(abs_mod).powModConstTime(*this, a);
+}
+
+BigInteger BigInteger::pow(int n)
+{   // only for positive n
+    BigInteger res(1ll);
+    BigInteger temp(*this);
+    if (n == 0) return res;
+    if (n == 1) return temp;
+
+    while (n)
+    {
+        if (n%2 == 1)
+        {
+            res *= temp;
+        }
+        temp = temp.square();
+        n /= 2;
+    }
+    return res;
+}
+
+int BigInteger::bitLength() const
+{
+    if (is_zero()) return 0;
+    int n = size();
+    int res = (n - 1) * BIT_PER_DIGIT;
+    int i = n - 1;
+    while (i >= 0 && digits[i] == 0) {
+        i--;
+    }
+    if (i >= 0) {
+        res += msbPosition(digits[i]);
+    }
+    return res;
+}
+
+// limbs of the number whose i-th least significant width-bit group is get(i), i < count
+template <class Get>
+static BigInteger pack_groups(size_t count, int width, Get get) {
+    LimbVector d;
+    d.reserve((count * width) / BIT_PER_DIGIT + 1);
+    u128 acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < count; i++) {
+        acc |= (u128)get(i) << bits;
+        bits += width;
+        if (bits >= BIT_PER_DIGIT) {
+            d.push_back((TYPE)acc);
+            acc >>= BIT_PER_DIGIT;
+            bits -= BIT_PER_DIGIT;
+        }
+    }
+    d.push_back((TYPE)acc);
+    BigInteger res;
+    res.setLimbs(std::move(d));
+    res.trim();
+    return res;
+}
+
+// put(i, g) for the i-th least significant width-bit group g of |x|, i < count
+template <class Put>
+static void unpack_groups(const BigInteger &x, size_t count, int width, Put put) {
+    const LimbVector &d = x.getLimbs();
+    ull mask = (1ull << width) - 1;
+    u128 acc = 0;
+    int bits = 0;
+    size_t limb = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (bits < width) {
+            acc |= (u128)(ull)(limb < d.size() ? d[limb] : 0) << bits;
+            limb++;
+            bits += BIT_PER_DIGIT;
+        }
+        put(i, (ull)acc & mask);
+        acc >>= width;
+        bits -= width;
+    }
+}
+
+void BigInteger::setDigits(const vector<TYPE> &digit) {
+    for (TYPE x : digit) {
+        if (x >> LEGACY_BIT_PER_DIGIT) {
+            throw "Digit out of range";
+        }
+    }
+    int s = sign;
+    *this = pack_groups(digit.size(), LEGACY_BIT_PER_DIGIT, [&](size_t i) { return digit[i]; });
+    sign = is_zero() ? 1 : s;
+}
+
+vector<TYPE> BigInteger::getDigits() const {
+    size_t count = max((bitLength() + LEGACY_BIT_PER_DIGIT - 1) / LEGACY_BIT_PER_DIGIT, 1);
+    vector<TYPE> res(count);
+    unpack_groups(*this, count, LEGACY_BIT_PER_DIGIT, [&](size_t i, ull g) { res[i] = g; });
+    return res;
+}
+
+// Radix conversion splits a number around cached powers 10^(19 * 2^k), down to leaves of
+// at most DECIMAL_LEAF_LIMBS limbs converted in chunks of 19 digits, the most that fit a limb
+const int DECIMAL_CHUNK_DIGITS = 19;
+const ull DECIMAL_CHUNK = 10000000000000000000ull;
+const int DECIMAL_LEAF_LIMBS = 40;
+
+// x as a one-limb number, for values that may not fit a signed ll
+static BigInteger from_limb(TYPE x) {
+    BigInteger res;
+    res.setLimbs(LimbVector(1, x));
+    return res;
+}
+
+struct DecimalPower {
+    BigInteger value; // 10^(19 * 2^k)
+    shared_ptr<const Reciprocal> reciprocal; // built on first use, parsing never needs it
+};
+
+static mutex decimal_power_mutex;
+static vector<shared_ptr<const DecimalPower>> decimal_power_cache;
+
+static shared_ptr<const DecimalPower> decimal_power(int k, bool with_reciprocal = false) {
+    lock_guard<mutex> lock(decimal_power_mutex);
+    // cached values outlive any scratch scope of the caller
+    LimbResourceScope heap(nullptr);
+    while ((int)decimal_power_cache.size() <= k) {
+        BigInteger value = decimal_power_cache.empty() ? from_limb(DECIMAL_CHUNK)
+                                                       : decimal_power_cache.back()->value.square();
+        decimal_power_cache.push_back(make_shared<const DecimalPower>(DecimalPower{value, nullptr}));
+    }
+    shared_ptr<const DecimalPower> &cached = decimal_power_cache[k];
+    if (with_reciprocal && !cached->reciprocal) {
+        cached = make_shared<const DecimalPower>(
+            DecimalPower{cached->value, make_shared<const Reciprocal>(cached->value)});
+    }
+    return cached;
+}
+
+// appends x >= 0, left-padded with zeros to width digits (no padding for width 0)
+static void write_decimal_leaf(const BigInteger &x, size_t width, string &out) {
+    LimbVector d = x.getLimbs();
+    vector<ull> chunks;
+    while (!d.empty()) {
+        // one short division by 10^19, high limb first
+        u128 rem = 0;
+        for (int i = d.size() - 1; i >= 0; i--) {
+            u128 cur = rem << BIT_PER_DIGIT | (ull)d[i];
+            d[i] = (TYPE)(cur / DECIMAL_CHUNK);
+            rem = cur % DECIMAL_CHUNK;
+        }
+        chunks.push_back((ull)rem);
+        while (!d.empty() && d.back() == 0) {
+            d.pop_back();
+        }
+    }
+
+    string digits = chunks.empty() ? "0" : to_string(chunks.back());
+    for (int i = (int)chunks.size() - 2; i >= 0; i--) {
+        string chunk = to_string(chunks[i]);
+        digits.append(DECIMAL_CHUNK_DIGITS - chunk.size(), '0');
+        digits += chunk;
+    }
+    if (width > digits.size()) {
+        out.append(width - digits.size(), '0');
+    }
+    out += digits;
+}
+
+// appends x >= 0 with x < 10^(19 * 2^(k + 1)), padded as in write_decimal_leaf
+static void write_decimal(const BigInteger &x, int k, size_t width, string &out) {
+    if (k < 0 || x.size() <= DECIMAL_LEAF_LIMBS) {
+        write_decimal_leaf(x, width, out);
+        return;
+    }
+    shared_ptr<const DecimalPower> p = decimal_power(k, true);
+    if (width == 0 && x < p->value) {
+        write_decimal(x, k - 1, 0, out);
+        return;
+    }
+    size_t low_width = (size_t)DECIMAL_CHUNK_DIGITS << k;
+    BigInteger q, r;
+    p->reciprocal->divmod(x, q, r);
+    write_decimal(q, k - 1, width == 0 ? 0 : width - low_width, out);
+    write_decimal(r, k - 1, low_width, out);
+}
+
+string BigInteger::toDecimal() const
+{
+    if (is_zero()) return "0";
+    BigInteger x = abs();
+    int k = 0;
+    if (x.size() > DECIMAL_LEAF_LIMBS) {
+        // smallest k with 10^(19 * 2^(k + 1)) > x
+        while (2 * (decimal_power(k)->value.bitLength() - 1) < x.bitLength()) {
+            k++;
+        }
+    }
+    string decimal = sign == -1 ? "-" : "";
+    write_decimal(x, k, 0, decimal);
+    return decimal;
+}
+
+// value of a string of digits: Horner on chunks of chunk_digits digits (whose value must fit
+// a limb) for short strings, else high * power(k) + low, with power(k) the value of a one
+// followed by chunk_digits * 2^k zeros, for the largest such power below the length
+template <class Digit, class Power>
+static BigInteger parse_chunked(string_view s, int chunk_digits, Digit &digit, Power &power) {
+    if (s.size() <= (size_t)chunk_digits * DECIMAL_LEAF_LIMBS) {
+        LimbVector d;
+        size_t pos = 0, first = s.size() % chunk_digits;
+        if (first == 0) first = chunk_digits;
+        while (pos < s.size()) {
+            size_t len = pos == 0 ? first : chunk_digits;
+            ull value = 0, scale = 1;
+            for (size_t i = pos; i < pos + len; i++) {
+                value = value * digit.base + digit(s[i]);
+                scale *= digit.base;
+            }
+            pos += len;
+
+            u128 carry = value;
+            for (TYPE &limb : d) {
+                u128 cur = (u128)(ull)limb * scale + carry;
+                limb = (TYPE)cur;
+                carry = cur >> BIT_PER_DIGIT;
+            }
+            while (carry > 0) {
+                d.push_back((TYPE)carry);
+                carry >>= BIT_PER_DIGIT;
+            }
+        }
+        if (d.empty()) {
+            d.push_back(0);
+        }
+        BigInteger res;
+        res.setLimbs(std::move(d));
+        res.trim();
+        return res;
+    }
+    int k = 0;
+    while (((size_t)chunk_digits << (k + 1)) < s.size()) {
+        k++;
+    }
+    size_t low = (size_t)chunk_digits << k;
+    BigInteger high = parse_chunked(s.substr(0, s.size() - low), chunk_digits, digit, power);
+    return high * power(k) + parse_chunked(s.substr(s.size() - low), chunk_digits, digit, power);
+}
+
+// value of a character as a digit 0-9, a-z or A-Z, checked against the base
+struct RadixDigit {
+    int base;
+
+    int operator()(char c) const {
+        int v = c >= '0' && c <= '9' ? c - '0'
+              : c >= 'a' && c <= 'z' ? c - 'a' + 10
+              : c >= 'A' && c <= 'Z' ? c - 'A' + 10 : 36;
+        if (v >= base) {
+            throw "Invalid digit for base";
+        }
+        return v;
+    }
+};
+
+static BigInteger parse_decimal(string_view s) {
+    RadixDigit digit{10};
+    auto power = [](int k) { return decimal_power(k)->value; };
+    return parse_chunked(s, DECIMAL_CHUNK_DIGITS, digit, power);
+}
+
+// value of s in any base from 2 to 36: powers of two are packed bitwise, other bases go
+// through parse_chunked with the powers built for this call
+static BigInteger parse_radix(string_view s, int base) {
+    if (base < 2 || base > 36) {
+        throw "Base must be between 2 and 36";
+    }
+    RadixDigit digit{base};
+    if ((base & (base - 1)) == 0) {
+        int width = __builtin_ctz(base);
+        size_t n = s.size();
+        return pack_groups(n, width, [&](size_t i) { return (ull)digit(s[n - 1 - i]); });
+    }
+    if (base == 10) {
+        return parse_decimal(s);
+    }
+
+    // chunk = base^chunk_digits, the largest power that fits a limb
+    int chunk_digits = 0;
+    ull chunk = 1;
+    while (chunk <= ~0ull / base) {
+        chunk *= base;
+        chunk_digits++;
+    }
+    vector<BigInteger> powers;
+    auto power = [&powers, chunk](int k) {
+        while ((int)powers.size() <= k) {
+            powers.push_back(powers.empty() ? from_limb(chunk) : powers.back().square());
+        }
+        return powers[k];
+    };
+    return parse_chunked(s, chunk_digits, digit, power);
+}
+
+BigInteger BigInteger::fromDecimal(string_view s)
+{
+    int sign = 1;
+    if (!s.empty() && (s[0] == '-' || s[0] == '+')) {
+        sign = s[0] == '-' ? -1 : 1;
+        s.remove_prefix(1);
+    }
+    if (s.empty()) {
+        throw "Empty decimal string";
+    }
+
+    BigInteger res = parse_decimal(s);
+    if (!res.is_zero()) {
+        res.sign = sign;
+    }
+    return res;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    throw "Invalid hex digit";
+}
+
+BigInteger BigInteger::fromHex(string_view s)
+{
+    int sign = 1;
+    if (!s.empty() && (s[0] == '-' || s[0] == '+')) {
+        sign = s[0] == '-' ? -1 : 1;
+        s.remove_prefix(1);
+    }
+    if (s.size() >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s.remove_prefix(2);
+    }
+    if (s.empty()) {
+        throw "Empty hex string";
+    }
+
+    size_t n = s.size();
+    BigInteger res = pack_groups(n, 4, [&s, n](size_t i) { return hex_value(s[n - 1 - i]); });
+    if (!res.is_zero()) {
+        res.sign = sign;
+    }
+    return res;
+}
+
+void BigInteger::toHex(span<char> out) const
+{
+    if ((size_t)(bitLength() + 3) / 4 > out.size()) {
+        throw "Hex buffer too small";
+    }
+    size_t n = out.size();
+    unpack_groups(*this, n, 4, [&out, n](size_t i, ull g) { out[n - 1 - i] = "0123456789abcdef"[g]; });
+}
+
+string BigInteger::toHex() const
+{
+    if (is_zero()) return "0";
+    int offset = sign == -1;
+    string hex(offset + (bitLength() + 3) / 4, '-');
+    toHex(span<char>(hex.data() + offset, hex.size() - offset));
+    return hex;
+}
+
+BigInteger BigInteger::fromBytes(span<const uint8_t> bytes, ByteOrder order)
+{
+    size_t n = bytes.size();
+    if (order == ByteOrder::BigEndian) {
+        return pack_groups(n, 8, [&bytes, n](size_t i) { return bytes[n - 1 - i]; });
+    }
+    return pack_groups(n, 8, [&bytes](size_t i) { return bytes[i]; });
+}
+
+size_t BigInteger::byteLength() const
+{
+    return (bitLength() + 7) / 8;
+}
+
+void BigInteger::toBytes(span<uint8_t> out, ByteOrder order) const
+{
+    if (byteLength() > out.size()) {
+        throw "Byte buffer too small";
+    }
+    size_t n = out.size();
+    if (order == ByteOrder::BigEndian) {
+        unpack_groups(*this, n, 8, [&out, n](size_t i, ull g) { out[n - 1 - i] = (uint8_t)g; });
+    } else {
+        unpack_groups(*this, n, 8, [&out](size_t i, ull g) { out[i] = (uint8_t)g; });
+    }
+}
+
+vector<uint8_t> BigInteger::toBytes(ByteOrder order) const
+{
+    vector<uint8_t> bytes(byteLength());
+    toBytes(span<uint8_t>(bytes), order);
+    return bytes;
+}
+
+BigInteger BigInteger::operator>>(int i) const {
+    if (i < 0) {
+        throw "Shift right must be positive";
+    }
+
+    if (i == 0) return *this;
+
+    int digitShift = i / BIT_PER_DIGIT; // number of digits to drop
+    int bitShift = i % BIT_PER_DIGIT; // number of bits to shift
+
+    int n = size();
+    BigInteger ans;
+    ans.sign = sign;
+    if (digitShift >= n) {
+        ans.trim();
+        return ans;
+    }
+
+    ans.digits.resize(n - digitShift);
+    rshift_limbs(ans.digits.data(), digits.data() + digitShift, n - digitShift, bitShift);
+    ans.trim();
+    return ans;
+}
+
+BigInteger BigInteger::operator<<(int i) const {
+    if(i < 0) {
+        throw "Shift left must be positive";
+    }
+    
+    if (i == 0) return *this;
+    
+    int digitShift = i / BIT_PER_DIGIT; // number of digits to shift
+    int bitShift = i % BIT_PER_DIGIT; // number of bits to shift
+
+    int n = size();
+    BigInteger ans;
+    ans.sign = sign;
+    ans.digits.resize(n + digitShift + 1, 0);
+    ans.digits[n + digitShift] = lshift_limbs(ans.digits.data() + digitShift, digits.data(), n, bitShift);
+
+    ans.trim();
+    return ans;
+}
+
+BigInteger &BigInteger::operator>>=(int i) {
+    if (i < 0) {
+        throw "Shift right must be positive";
+    }
+
+    int digitShift = i / BIT_PER_DIGIT; // number of digits to drop
+    int bitShift = i % BIT_PER_DIGIT; // number of bits to shift
+
+    int n = size();
+    if (digitShift >= n) {
+        digits.clear();
+        trim();
+        return *this;
+    }
+
+    // reads stay at or above the limb being written
+    rshift_limbs(digits.data(), digits.data() + digitShift, n - digitShift, bitShift);
+    digits.resize(n - digitShift);
+    trim();
+    return *this;
+}
+
+BigInteger &BigInteger::operator<<=(int i) {
+    if (i < 0) {
+        throw "Shift left must be positive";
+    }
+
+    int digitShift = i / BIT_PER_DIGIT; // number of digits to shift
+    int bitShift = i % BIT_PER_DIGIT; // number of bits to shift
+
+    int n = size();
+    digits.resize(n + digitShift + 1);
+    TYPE *d = digits.data();
+    TYPE top = lshift_limbs(d, d, n, bitShift);
+    if (digitShift > 0) {
+        copy_backward(d, d + n, d + n + digitShift);
+        fill(d, d + digitShift, 0);
+    }
+    d[n + digitShift] = top;
+    trim();
+    return *this;
+}
+
+bool BigInteger::is_even() const {
+    return (digits[0] % 2 == 0);
+}
+
+// divisors (in limbs) from which divide() goes through a Reciprocal instead of Algorithm D
+static const int DIVIDE_NEWTON_THRESHOLD = 1000;
+
+// limbs [from, to) of x, clamped to its size
+static BigInteger limb_slice(const BigInteger &x, int from, int to) {
+    const LimbVector &d = x.getLimbs();
+    to = min(to, (int)d.size());
+    BigInteger res;
+    if (from >= to) {
+        res.setLimbs(LimbVector(1, 0));
+        return res;
+    }
+    res.setLimbs(LimbVector(d.begin() + from, d.begin() + to));
+    res.trim();
+    return res;
+}
+
+// Approximates 2^(2k) / d for 2^(k-1) <= d < 2^k to within a few units. The reciprocal of
+// the top half of d gives a start value with about k/2 correct bits and one Newton step
+// x + x(2^2k - dx) / 2^2k doubles that.
+static BigInteger newton_reciprocal(const BigInteger &d, int k) {
+    BigInteger one(1ll);
+    if (k <= 8 * BIT_PER_DIGIT) {
+        return (one << (2 * k)) / d;
+    }
+
+    int h = k / 2 + 1;
+    BigInteger temp(d);
+    BigInteger x = newton_reciprocal(temp >> (k - h), h) << (k - h);
+
+    BigInteger e = (one << (2 * k)) - d * x;
+    return x + ((x * e) >> (2 * k));
+}
+
+// floor(2^(2k) / d), the Newton result fixed against the exact remainder
+static BigInteger exact_reciprocal(const BigInteger &d, int k) {
+    BigInteger one(1ll);
+    BigInteger x = newton_reciprocal(d, k);
+    BigInteger r = (one << (2 * k)) - d * x;
+    while (r.getSign() < 0) {
+        x -= one;
+        r += d;
+    }
+    while (r >= d) {
+        x += one;
+        r -= d;
+    }
+    return x;
+}
+
+Reciprocal::Reciprocal(const BigInteger &divisor) : d(divisor) {
+    if (divisor.is_zero()) {
+        throw "Divide by zero";
+    }
+    BigInteger temp = divisor.abs();
+    temp.trim();
+    shift = BIT_PER_DIGIT - msbPosition(temp.getLimbs().back());
+    norm = temp << shift;
+    inv = exact_reciprocal(norm, norm.size() * BIT_PER_DIGIT);
+}
+
+const BigInteger &Reciprocal::divisor() const {
+    return d;
+}
+
+void Reciprocal::divmod(const BigInteger &a, BigInteger &quotient, BigInteger &remainder) const {
+    // long division of a * 2^shift in base BASE^m; every step divides a value below
+    // norm * BASE^m by norm with one Barrett reduction (HAC 14.42)
+    int m = norm.size();
+    BigInteger x = a.abs();
+    x <<= shift;
+    int n = x.size();
+    int chunks = (n + m - 1) / m;
+
+    LimbVector q(chunks * m, 0);
+    BigInteger rem(0ll);
+    for (int i = chunks - 1; i >= 0; i--) {
+        LimbVector cur_digits(2 * m, 0);
+        const LimbVector &xd = x.getLimbs();
+        for (int j = i * m; j < min((i + 1) * m, n); j++) {
+            cur_digits[j - i * m] = xd[j];
+        }
+        const LimbVector &rd = rem.getLimbs();
+        copy(rd.begin(), rd.end(), cur_digits.begin() + m);
+        BigInteger cur;
+        cur.setLimbs(std::move(cur_digits));
+        cur.trim();
+
+        BigInteger q3 = limb_slice(limb_slice(cur, m - 1, 2 * m) * inv, m + 1, 3 * m + 2);
+        BigInteger r = cur - q3 * norm;
+        while (r >= norm) {
+            r -= norm;
+            q3 += BigInteger(1ll);
+        }
+
+        const LimbVector &qd = q3.getLimbs();
+        copy(qd.begin(), qd.end(), q.begin() + i * m);
+        rem = std::move(r);
+    }
+
+    quotient.setLimbs(std::move(q));
+    quotient.setSign(a.getSign() * d.getSign());
+    quotient.trim();
+    remainder = rem >> shift;
+    remainder.setSign(a.getSign());
+    remainder.trim();
+}
+
+BigInteger Reciprocal::quotient(const BigInteger &a) const {
+    BigInteger q, r;
+    divmod(a, q, r);
+    return q;
+}
+
+BigInteger Reciprocal::remainder(const BigInteger &a) const {
+    BigInteger q, r;
+    divmod(a, q, r);
+    return r;
+}
+
+// quotient and remainder of |a| / |b|, either output may be null
+static void divmod_abs(const BigInteger &a, const BigInteger &b, BigInteger *quotient, BigInteger *remainder) {
+    if (b.is_zero()) {
+        throw "Divide by zero";
+    }
+
+    const LimbVector &x = a.getLimbs();
+    const LimbVector &y = b.getLimbs();
+    int n = x.size(), m = y.size();
+    while (n > 0 && x[n - 1] == 0) n--;
+    while (y[m - 1] == 0) m--;
+
+    if (n < m) {
+        if (quotient) *quotient = BigInteger(0ll);
+        if (remainder) *remainder = a.abs();
+        return;
+    }
+
+    if (m >= DIVIDE_NEWTON_THRESHOLD && n - m >= DIVIDE_NEWTON_THRESHOLD / 2) {
+        BigInteger q, r;
+        Reciprocal(b.abs()).divmod(a.abs(), q, r);
+        if (quotient) *quotient = std::move(q);
+        if (remainder) *remainder = std::move(r);
+        return;
+    }
+
+    LimbVector q(quotient ? n - m + 1 : 0), r(remainder ? m : 0);
+    divmod_limbs(quotient ? q.data() : nullptr, remainder ? r.data() : nullptr, x.data(), n, y.data(), m);
+    if (quotient) {
+        quotient->setLimbs(std::move(q));
+        quotient->setSign(1);
+        quotient->trim();
+    }
+    if (remainder) {
+        remainder->setLimbs(std::move(r));
+        remainder->setSign(1);
+        remainder->trim();
+    }
+}
+
+BigInteger BigInteger::operator/(const BigInteger &a) const {
+    // truncates toward zero
+    BigInteger q;
+    divmod_abs(*this, a, &q, nullptr);
+    q.setSign(sign * a.sign);
+    q.trim();
+    return q;
+}
+
+BigInteger BigInteger::operator%(const BigInteger &a) const {
+    // the remainder takes the sign of *this, as with the built-in %
+    BigInteger r;
+    divmod_abs(*this, a, nullptr, &r);
+    r.setSign(sign);
+    r.trim();
+    return r;
+}
+
+BigInteger &BigInteger::operator*=(const BigInteger &a) {
+    // the product needs its own buffer, the old one is released by the move
+    *this = *this * a;
+    return *this;
+}
+
+BigInteger &BigInteger::operator/=(const BigInteger &a) {
+    *this = *this / a;
+    return *this;
+}
+
+BigInteger &BigInteger::operator%=(const BigInteger &a) {
+    *this = *this % a;
+    return *this;
+}
+
+// Lehmer's extended Euclid works on the leading 62 bits of u >= v and only touches the full
+// numbers once per batch of quotients; from GCD_HGCD_THRESHOLD bits on, a half-gcd
+// reduces the operands by half their size with a few full-size multiplications.
+const int GCD_HGCD_THRESHOLD = 6000; // bits
+const int LEHMER_BITS = 62;
+
+static BigInteger negated(BigInteger x) {
+    x.setSign(-x.getSign());
+    x.trim();
+    return x;
+}
+
+// bits [h, h + LEHMER_BITS) of x >= 0
+static ll leading_bits(const BigInteger &x, int h) {
+    const LimbVector &d = x.getLimbs();
+    int i = h / BIT_PER_DIGIT;
+    if (i >= (int)d.size()) return 0;
+    u128 w = (ull)d[i];
+    if (i + 1 < (int)d.size()) {
+        w |= (u128)(ull)d[i + 1] << BIT_PER_DIGIT;
+    }
+    return (ll)((w >> (h % BIT_PER_DIGIT)) & ((1ull << LEHMER_BITS) - 1));
+}
+
+// Knuth, TAOCP vol. 2, 4.5.2, Algorithm L: runs Euclid on the leading bits of u >= v > 0
+// while the quotients provably equal the full ones, giving (u', v') = (A u + B v, C u + D v).
+// Stops early once v' would drop to stop_bits bits. B == 0 means no quotient was certain.
+static void lehmer_matrix(const BigInteger &u, const BigInteger &v, int stop_bits, ll &A, ll &B, ll &C, ll &D) {
+    int h = max(0, u.bitLength() - LEHMER_BITS);
+    ll uh = leading_bits(u, h), vh = v.bitLength() > h ? leading_bits(v, h) : 0;
+    A = 1, B = 0, C = 0, D = 1;
+    while (vh != 0 && vh + C != 0 && vh + D != 0) {
+        ll q = (uh + A) / (vh + C);
+        if (q != (uh + B) / (vh + D)) break;
+        ll t = A - q * C;
+        A = C, C = t;
+        t = B - q * D;
+        B = D, D = t;
+        t = uh - q * vh;
+        uh = vh, vh = t;
+        if (64 - __builtin_clzll(vh | 1) + h <= stop_bits) break;
+    }
+}
+
+// a x + b y for |a|, |b| <= 2^62 in one pass over the limbs: the two products are added
+// with an unsigned carry or subtracted with a signed one, and a negative total is negated
+// at the end
+static BigInteger lehmer_combine(const BigInteger &x, ll a, const BigInteger &y, ll b) {
+    const LimbVector &xd = x.getLimbs(), &yd = y.getLimbs();
+    int sx = (a < 0 ? -1 : 1) * x.getSign(), sy = (b < 0 ? -1 : 1) * y.getSign();
+    ull ma = a < 0 ? -(ull)a : a, mb = b < 0 ? -(ull)b : b;
+    int nx = xd.size(), ny = yd.size(), n = max(nx, ny) + 1;
+
+    LimbVector r(n);
+    bool negative = false;
+    if (sx == sy) {
+        // both products are below 2^126, so their sum and the carry fit 128 bits
+        u128 carry = 0;
+        for (int i = 0; i < n; i++) {
+            u128 t = carry;
+            if (i < nx) t += (u128)xd[i] * ma;
+            if (i < ny) t += (u128)yd[i] * mb;
+            r[i] = (TYPE)t;
+            carry = t >> BIT_PER_DIGIT;
+        }
+    } else {
+        __int128 carry = 0;
+        for (int i = 0; i < n; i++) {
+            __int128 t = carry;
+            if (i < nx) t += (__int128)((u128)xd[i] * ma);
+            if (i < ny) t -= (__int128)((u128)yd[i] * mb);
+            r[i] = (TYPE)t;
+            carry = t >> BIT_PER_DIGIT;
+        }
+        negative = carry < 0;
+    }
+    if (negative) {
+        TYPE borrow = 0;
+        for (int i = 0; i < n; i++) {
+            r[i] = sub_borrow(0, r[i], borrow);
+        }
+        sx = -sx;
+    }
+
+    BigInteger res;
+    res.setLimbs(std::move(r));
+    res.setSign(sx);
+    res.trim();
+    return res;
+}
+
+// (u, v) = (A u + B v, C u + D v)
+static void lehmer_apply(BigInteger &u, BigInteger &v, ll A, ll B, ll C, ll D) {
+    BigInteger t = lehmer_combine(u, A, v, B);
+    v = lehmer_combine(u, C, v, D);
+    u = std::move(t);
+}
+
+// 2x2 integer matrix with determinant det = +-1
+struct GcdMatrix {
+    BigInteger m00, m01, m10, m11;
+    int det;
+};
+
+static GcdMatrix gcd_identity() {
+    return {BigInteger(1ll), BigInteger(0ll), BigInteger(0ll), BigInteger(1ll), 1};
+}
+
+static GcdMatrix gcd_mul(const GcdMatrix &x, const GcdMatrix &y) {
+    return {x.m00 * y.m00 + x.m01 * y.m10, x.m00 * y.m01 + x.m01 * y.m11,
+            x.m10 * y.m00 + x.m11 * y.m10, x.m10 * y.m01 + x.m11 * y.m11, x.det * y.det};
+}
+
+// (a, b) = M^-1 (a, b)
+static void gcd_apply_inverse(const GcdMatrix &m, BigInteger &a, BigInteger &b) {
+    BigInteger c = m.m11 * a - m.m01 * b;
+    BigInteger d = m.m00 * b - m.m10 * a;
+    a = m.det > 0 ? c : negated(c);
+    b = m.det > 0 ? d : negated(d);
+}
+
+// a -= q b, tracked in m as (a, b) = M [[1, q], [0, 1]] (a - q b, b)
+static void gcd_reduce_first(GcdMatrix &m, BigInteger &a, BigInteger &b, const BigInteger &q) {
+    a -= q * b;
+    m.m01 += m.m00 * q;
+    m.m11 += m.m10 * q;
+}
+
+// b -= q a, tracked in m as (a, b) = M [[1, 0], [q, 1]] (a, b - q a)
+static void gcd_reduce_second(GcdMatrix &m, BigInteger &a, BigInteger &b, const BigInteger &q) {
+    b -= q * a;
+    m.m00 += m.m01 * q;
+    m.m10 += m.m11 * q;
+}
+
+// floor(a / b) for b > 0
+static BigInteger floor_div(const BigInteger &a, const BigInteger &b) {
+    BigInteger q = a / b;
+    if (a.getSign() < 0 && !(q * b == a)) {
+        q -= BigInteger(1ll);
+    }
+    return q;
+}
+
+// brings a reduced pair back to a > b >= 0 after quotients taken from the leading bits
+// overshot, keeping (original) = M (a, b)
+static void gcd_fixup(GcdMatrix &m, BigInteger &a, BigInteger &b) {
+    if (a.getSign() < 0 && b.getSign() < 0) {
+        a = negated(a), b = negated(b);
+        m = {negated(m.m00), negated(m.m01), negated(m.m10), negated(m.m11), m.det};
+    }
+    if (b.getSign() < 0) gcd_reduce_second(m, a, b, floor_div(b, a));
+    if (a.getSign() < 0) gcd_reduce_first(m, a, b, floor_div(a, b));
+    if (a < b) {
+        swap(a, b);
+        swap(m.m00, m.m01);
+        swap(m.m10, m.m11);
+        m.det = -m.det;
+    }
+}
+
+// one Euclid step (a, b) -> (b, a mod b), tracked in m as (a, b) = M [[q, 1], [1, 0]] (b, r)
+static void gcd_division_step(GcdMatrix &m, BigInteger &a, BigInteger &b) {
+    BigInteger q, r;
+    divmod_abs(a, b, &q, &r);
+    a = b;
+    b = r;
+    m = {m.m00 * q + m.m01, m.m00, m.m10 * q + m.m11, m.m10, -m.det};
+}
+
+// one Lehmer step or, if it certified no quotient, one division step
+static void gcd_lehmer_step(GcdMatrix &m, BigInteger &a, BigInteger &b, int stop_bits) {
+    ll A, B, C, D;
+    lehmer_matrix(a, b, stop_bits, A, B, C, D);
+    if (B == 0) {
+        gcd_division_step(m, a, b);
+        return;
+    }
+    lehmer_apply(a, b, A, B, C, D);
+    // M = M [[A, B], [C, D]]^-1 = det M [[D, -B], [-C, A]]
+    if ((__int128)A * D - (__int128)B * C < 0) {
+        A = -A, B = -B, C = -C, D = -D;
+        m.det = -m.det;
+    }
+    BigInteger t = lehmer_combine(m.m00, D, m.m01, -C);
+    m.m01 = lehmer_combine(m.m00, -B, m.m01, A);
+    m.m00 = std::move(t);
+    t = lehmer_combine(m.m10, D, m.m11, -C);
+    m.m11 = lehmer_combine(m.m10, -B, m.m11, A);
+    m.m10 = std::move(t);
+}
+
+// Half-gcd: reduces a > b >= 0 to a consecutive pair with b of at most s bits, where
+// s >= a.bitLength() / 2, and returns M with (a, b) = M (a', b'). Each half of the work
+// is done recursively on the leading bits only, whose quotients agree with the full ones
+// for as long as the remainders stay larger than the cofactors, i.e. for half the bits.
+static GcdMatrix hgcd(BigInteger &a, BigInteger &b, int s) {
+    GcdMatrix m = gcd_identity();
+    if (b.bitLength() <= s) return m;
+
+    int n = a.bitLength();
+    if (n < GCD_HGCD_THRESHOLD) {
+        while (b.bitLength() > s) {
+            gcd_lehmer_step(m, a, b, s);
+        }
+        return m;
+    }
+
+    // first quarter: the top n - s bits, reduced to half their size
+    BigInteger a1 = a >> s, b1 = b >> s;
+    m = hgcd(a1, b1, a1.bitLength() / 2 + 1);
+    gcd_apply_inverse(m, a, b);
+    gcd_fixup(m, a, b);
+
+    // second quarter: the top twice the bits still to be removed; a plain step whenever
+    // that would not shrink the problem or made no progress
+    while (b.bitLength() > s) {
+        int n2 = a.bitLength();
+        int p = max(0, 2 * s - n2 - 2);
+        if (n2 - p < n) {
+            BigInteger a2 = a >> p, b2 = b >> p;
+            GcdMatrix m2 = hgcd(a2, b2, (n2 - p) / 2 + 1);
+            if (!m2.m01.is_zero() || !m2.m10.is_zero()) {
+                gcd_apply_inverse(m2, a, b);
+                gcd_fixup(m2, a, b);
+                m = gcd_mul(m, m2);
+                continue;
+            }
+        }
+        gcd_lehmer_step(m, a, b, s);
+    }
+    return m;
+}
+
+// gcd(u, v) for u, v >= 0; if cofactor is given, u >= v and it receives x with
+// x u = gcd (mod v), or x v = gcd (mod u) for cofactor_of_v
+static BigInteger gcd_abs(BigInteger u, BigInteger v, BigInteger *cofactor, bool cofactor_of_v = false) {
+    if (u < v) {
+        swap(u, v);
+    }
+    // u = su * w (mod the other input), v = sv * w, for w the input whose cofactor is tracked
+    BigInteger su((ll)!cofactor_of_v), sv((ll)cofactor_of_v);
+    while (!v.is_zero()) {
+        if (u.bitLength() >= GCD_HGCD_THRESHOLD && u.bitLength() - v.bitLength() < u.bitLength() / 4) {
+            GcdMatrix m = hgcd(u, v, u.bitLength() / 2 + 1);
+            if (cofactor) {
+                gcd_apply_inverse(m, su, sv);
+            }
+            continue;
+        }
+
+        ll A, B, C, D;
+        lehmer_matrix(u, v, -1, A, B, C, D);
+        if (B != 0) {
+            lehmer_apply(u, v, A, B, C, D);
+            if (cofactor) {
+                lehmer_apply(su, sv, A, B, C, D);
+            }
+            continue;
+        }
+        BigInteger q, r;
+        divmod_abs(u, v, &q, &r);
+        u = std::move(v);
+        v = std::move(r);
+        if (cofactor) {
+            // (su, sv) = (sv, su - q sv)
+            su -= q * sv;
+            swap(su, sv);
+        }
+    }
+    if (cofactor) {
+        *cofactor = std::move(su);
+    }
+    return u;
+}
+
+auto bezout(const BigInteger &x, const BigInteger &y) {
+    struct Ans {
+        BigInteger a, b;
+        BigInteger d; // Bezout => ax + by = gcd(x,y) = d
+    };
+
+    BigInteger zero(0ll);
+    Ans ans{zero, zero, zero};
+    if (x.is_zero() && y.is_zero()) {
+        return ans;
+    }
+    // ans predates the scope, so assigning to it copies the results out of the arena
+    ScratchScope scratch;
+
+    // cofactor of the larger of |x|, |y|, then the other one from the identity
+    BigInteger ax = x.abs(), ay = y.abs();
+    bool x_larger = !(ax < ay);
+    BigInteger s;
+    BigInteger d = x_larger ? gcd_abs(ax, ay, &s) : gcd_abs(ay, ax, &s);
+    const BigInteger &big = x_larger ? ax : ay;
+    const BigInteger &small = x_larger ? ay : ax;
+
+    // keep |s| below small / d, as plain Euclid would
+    if (!small.is_zero()) {
+        BigInteger bound = small / d;
+        if (!(s.abs() < bound)) {
+            s %= bound;
+        }
+    }
+    BigInteger t = small.is_zero() ? zero : (d - s * big) / small;
+
+    ans.a = x_larger ? s : t;
+    ans.b = x_larger ? t : s;
+    if (x.getSign() < 0) ans.a = negated(ans.a);
+    if (y.getSign() < 0) ans.b = negated(ans.b);
+    ans.d = d;
+    return ans;
+}
+
+BigInteger gcd(const BigInteger &x, const BigInteger &y) {
+    BigInteger res;
+    ScratchScope scratch;
+    res = gcd_abs(x.abs(), y.abs(), nullptr);
+    return res;
+}
+
+int msbPosition(ull x)
+{
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+auto divide(const BigInteger &a, const BigInteger &b) {
+    struct res {
+        BigInteger quotient;
+        BigInteger remainder;
+    };
+
+    res answer;
+    divmod_abs(a, b, &answer.quotient, &answer.remainder);
+
+    answer.quotient.setSign(a.getSign() * b.getSign());
+    answer.quotient.trim();
+    answer.remainder.setSign(a.getSign());
+    answer.remainder.trim();
+
+    return answer;
+}
+
+BigInteger lcm(const BigInteger &x, const BigInteger &y) {
+    if (x.is_zero() || y.is_zero()) {
+        return BigInteger(0ll);
+    }
+    // divide before multiplying so the product never exceeds the result
+    return x.abs() / gcd(x, y) * y.abs();
+}
+
+// bit i of the limbs of e, zero past the end
+static int exponent_bit(const LimbVector &e, int i) {
+    int limb = i / BIT_PER_DIGIT;
+    if (limb >= (int)e.size()) return 0;
+    return (e[limb] >> (i % BIT_PER_DIGIT)) & 1;
+}
+
+int window_size(int bits) {
+    if (bits <= 7) return 1;
+    if (bits <= 25) return 2;
+    if (bits <= 81) return 3;
+    if (bits <= 241) return 4;
+    if (bits <= 673) return 5;
+    if (bits <= 1793) return 6;
+    return 7;
+}
+
+// Left-to-right sliding-window exponentiation over any representation T, with mul(r, a)
+// and sqr(r) updating r in place. Only odd powers x, x^3, ..., x^(2^w - 1) are tabulated.
+template <class T, class Mul, class Sqr>
+static T sliding_window_pow(const T &x, const T &one, const BigInteger &e, Mul mul, Sqr sqr) {
+    int bits = e.bitLength();
+    if (bits == 0) return one;
+    const LimbVector &y = e.getLimbs();
+    int w = window_size(bits);
+
+    std::pmr::vector<T> table(1 << (w - 1), x, LimbVector::resource());
+    if (w > 1) {
+        T x2 = x;
+        sqr(x2);
+        for (size_t i = 1; i < table.size(); i++) {
+            table[i] = table[i - 1];
+            mul(table[i], x2);
+        }
+    }
+
+    T res = one;
+    bool started = false;
+    for (int i = bits - 1; i >= 0;) {
+        if (!exponent_bit(y, i)) {
+            if (started) sqr(res);
+            i--;
+            continue;
+        }
+        // longest window e[j..i] of at most w bits that ends in a set bit
+        int j = max(i - w + 1, 0);
+        while (!exponent_bit(y, j)) j++;
+        int value = 0;
+        for (int l = i; l >= j; l--) {
+            value = (value << 1) | exponent_bit(y, l);
+        }
+        if (started) {
+            for (int l = j; l <= i; l++) sqr(res);
+            mul(res, table[value >> 1]);
+        } else {
+            res = table[value >> 1];
+            started = true;
+        }
+        i = j - 1;
+    }
+    return res;
+}
+
+// x as exactly k limbs, x must fit
+static LimbVector pad_limbs(const BigInteger &x, int k) {
+    LimbVector res = x.getLimbs();
+    res.resize(k, 0);
+    return res;
+}
+
+MontgomeryContext::MontgomeryContext(const BigInteger &modulus) {
+    n = modulus.abs();
+    n.trim();
+    if (n.is_even() || n <= BigInteger(1ll)) {
+        throw "Montgomery modulus must be odd and greater than 1";
+    }
+    mod.assign(n.getLimbs().begin(), n.getLimbs().end());
+    k = mod.size();
+
+    // Newton iteration for n^-1 mod 2^64, each step doubles the number of correct low bits
+    ull n0 = mod[0], inv = n0;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - n0 * inv;
+    }
+    ninv = (TYPE)(0 - inv);
+
+    BigInteger R = BigInteger(1ll) << (k * BIT_PER_DIGIT);
+    one = pad_limbs(R % n, k);
+    r2 = pad_limbs((R * R) % n, k);
+}
+
+const BigInteger &MontgomeryContext::modulus() const {
+    return n;
+}
+
+int MontgomeryContext::limbs() const {
+    return k;
+}
+
+// t[0..k] = a * b * R^-1 mod n, below 2n, for a * b < n * R. CIOS: one row of the product is
+// interleaved with one reduction step, t needs k + 2 limbs. The loops depend only on k.
+static void cios_mul(TYPE *t, const TYPE *a, const TYPE *b, const TYPE *m, int k, TYPE ninv) {
+    fill(t, t + k + 2, 0);
+    for (int i = 0; i < k; i++) {
+        ull bi = b[i];
+        ull carry = 0;
+        for (int j = 0; j < k; j++) {
+            u128 cur = (u128)(ull)a[j] * bi + (ull)t[j] + carry;
+            t[j] = (TYPE)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        TYPE c = 0;
+        t[k] = add_carry(t[k], carry, c);
+        t[k + 1] = c;
+
+        ull q = (ull)t[0] * (ull)ninv;
+        u128 cur = (u128)q * (ull)m[0] + (ull)t[0];
+        carry = (ull)(cur >> BIT_PER_DIGIT);
+        for (int j = 1; j < k; j++) {
+            cur = (u128)q * (ull)m[j] + (ull)t[j] + carry;
+            t[j - 1] = (TYPE)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        c = 0;
+        t[k - 1] = add_carry(t[k], carry, c);
+        t[k] = t[k + 1] + c;
+    }
+}
+
+// r[0..k) = t - m if top * BASE^k + t >= m and t otherwise, for values below 2m. The
+// subtraction always runs and the result is picked by a mask, so there is no branch or early
+// exit on t; r may alias t.
+static void ct_reduce(TYPE *r, const TYPE *t, TYPE top, const TYPE *m, int k) {
+    TYPE borrow = 0;
+    for (int j = 0; j < k; j++) {
+        sub_borrow(t[j], m[j], borrow);
+    }
+    TYPE mask = (TYPE)0 - (top | (borrow ^ 1));
+    borrow = 0;
+    for (int j = 0; j < k; j++) {
+        r[j] = sub_borrow(t[j], m[j] & mask, borrow);
+    }
+}
+
+void MontgomeryContext::redc(TYPE *r, TYPE *t) const {
+    // SOS reduction: clear the low limb of t one at a time by adding multiples of n
+    const TYPE *m = mod.data();
+    for (int i = 0; i < k; i++) {
+        ull q = (ull)t[i] * (ull)ninv;
+        ull carry = 0;
+        for (int j = 0; j < k; j++) {
+            u128 cur = (u128)q * (ull)m[j] + (ull)t[i + j] + carry;
+            t[i + j] = (TYPE)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        TYPE c = 0;
+        t[i + k] = add_carry(t[i + k], carry, c);
+        for (int p = i + k + 1; c; p++) {
+            t[p] = add_carry(t[p], 0, c);
+        }
+    }
+    // t / R = t[k..2k] < 2n
+    ct_reduce(r, t + k, t[2 * k], m, k);
+}
+
+void MontgomeryContext::mul(TYPE *r, const TYPE *a, const TYPE *b) const {
+    static thread_local vector<TYPE> buf;
+    const TYPE *m = mod.data();
+
+    if (k >= mul_thresholds.karatsuba) {
+        // large moduli: subquadratic product, then a separate reduction
+        buf.resize(2 * k + 1 + mul_scratch_size(k));
+        TYPE *t = buf.data();
+        mul_limbs(t, a, k, b, k, t + 2 * k + 1);
+        t[2 * k] = 0;
+        redc(r, t);
+        return;
+    }
+
+    buf.resize(k + 2);
+    TYPE *t = buf.data();
+    cios_mul(t, a, b, m, k, ninv);
+    ct_reduce(r, t, t[k], m, k);
+}
+
+void MontgomeryContext::mul_ct(TYPE *r, const TYPE *a, const TYPE *b) const {
+    static thread_local vector<TYPE> buf;
+    buf.resize(k + 2);
+    TYPE *t = buf.data();
+    cios_mul(t, a, b, mod.data(), k, ninv);
+    ct_reduce(r, t, t[k], mod.data(), k);
+}
+
+void MontgomeryContext::sqr(TYPE *r, const TYPE *a) const {
+    static thread_local vector<TYPE> buf;
+    buf.resize(2 * k + 1 + (k < mul_thresholds.karatsuba ? 0 : mul_scratch_size(k)));
+    TYPE *t = buf.data();
+    sqr_limbs(t, a, k, t + 2 * k + 1);
+    t[2 * k] = 0;
+    redc(r, t);
+}
+
+void MontgomeryContext::add(TYPE *r, const TYPE *a, const TYPE *b) const {
+    TYPE carry = add_n(r, a, b, k);
+    ct_reduce(r, r, carry, mod.data(), k);
+}
+
+void MontgomeryContext::sub(TYPE *r, const TYPE *a, const TYPE *b) const {
+    // add n back under a mask that is all ones exactly when a - b borrowed
+    TYPE mask = (TYPE)0 - sub_n(r, a, b, k);
+    TYPE carry = 0;
+    for (int j = 0; j < k; j++) {
+        r[j] = add_carry(r[j], mod[j] & mask, carry);
+    }
+}
+
+void MontgomeryContext::half(TYPE *r, const TYPE *a) const {
+    // a / 2 = (a + n) / 2 for odd a; the carry out of a + n becomes the top bit
+    TYPE carry = 0;
+    if (a[0] & 1) {
+        carry = add_n(r, a, mod.data(), k);
+        a = r;
+    }
+    rshift1(r, a, k);
+    r[k - 1] |= carry << (BIT_PER_DIGIT - 1);
+}
+
+void MontgomeryContext::to_montgomery(TYPE *r, const BigInteger &x) const {
+    BigInteger reduced = x % n;
+    if (reduced.getSign() < 0) {
+        reduced += n;
+    }
+    const LimbVector &d = reduced.getLimbs();
+    fill(copy(d.begin(), d.begin() + min((int)d.size(), k), r), r + k, 0);
+    mul(r, r, r2.data());
+}
+
+void MontgomeryContext::to_montgomery_ct(TYPE *r, const BigInteger &x) const {
+    // Horner over k-limb chunks from the top: (acc * R + c) * R = mul(acc R, R^2) + mul(c, R^2),
+    // and every chunk is below R, so each product stays within mul_ct's bound
+    const LimbVector &d = x.getLimbs();
+    int size = d.size();
+    vector<TYPE> c(k);
+    fill(r, r + k, 0);
+    for (int from = (size - 1) / k * k; from >= 0; from -= k) {
+        fill(copy(d.begin() + from, d.begin() + min(from + k, size), c.begin()), c.end(), 0);
+        mul_ct(r, r, r2.data());
+        mul_ct(c.data(), c.data(), r2.data());
+        add(r, r, c.data());
+    }
+    if (x.getSign() < 0) {
+        fill(c.begin(), c.end(), 0);
+        sub(r, c.data(), r);
+    }
+}
+
+BigInteger MontgomeryContext::from_montgomery(const TYPE *x) const {
+    LimbVector t(2 * k + 1, 0);
+    copy(x, x + k, t.begin());
+    LimbVector digits(k);
+    redc(digits.data(), t.data());
+    BigInteger res;
+    res.setLimbs(std::move(digits));
+    res.trim();
+    return res;
+}
+
+vector<TYPE> MontgomeryContext::toMontgomery(const BigInteger &x) const {
+    vector<TYPE> res(k);
+    to_montgomery(res.data(), x);
+    return res;
+}
+
+BigInteger MontgomeryContext::fromMontgomery(const vector<TYPE> &x) const {
+    return from_montgomery(x.data());
+}
+
+BigInteger MontgomeryContext::mulMod(const BigInteger &a, const BigInteger &b) const {
+    vector<TYPE> x = toMontgomery(a), y = toMontgomery(b);
+    mul(x.data(), x.data(), y.data());
+    return fromMontgomery(x);
+}
+
+vector<TYPE> MontgomeryContext::pow(const vector<TYPE> &x, const BigInteger &e) const {
+    return sliding_window_pow(x, vector<TYPE>(one.begin(), one.end()), e,
+                              [this](vector<TYPE> &r, const vector<TYPE> &a) { mul(r.data(), r.data(), a.data()); },
+                              [this](vector<TYPE> &r) { sqr(r.data(), r.data()); });
+}
+
+vector<TYPE> MontgomeryContext::powConstTime(const vector<TYPE> &x, const BigInteger &e) const {
+    // Fixed windows over a bit count that depends only on the limb counts, with every table
+    // entry read for each lookup and mul_ct for every product, so neither the sequence of
+    // operations nor the memory access pattern depends on the exponent bits.
+    int bits = max(e.size(), k) * BIT_PER_DIGIT;
+    int w = min(window_size(bits), 5);
+    const LimbVector &y = e.getLimbs();
+
+    vector<vector<TYPE>> table(1 << w, vector<TYPE>(one.begin(), one.end()));
+    for (size_t i = 1; i < table.size(); i++) {
+        mul_ct(table[i].data(), table[i - 1].data(), x.data());
+    }
+
+    vector<TYPE> res(one.begin(), one.end()), selected(k);
+    for (int top = (bits + w - 1) / w * w - 1; top >= 0; top -= w) {
+        int value = 0;
+        for (int l = top; l > top - w; l--) {
+            mul_ct(res.data(), res.data(), res.data());
+            value = (value << 1) | exponent_bit(y, l);
+        }
+        fill(selected.begin(), selected.end(), 0);
+        for (size_t i = 0; i < table.size(); i++) {
+            TYPE mask = (TYPE)0 - (TYPE)(i == (size_t)value);
+            for (int j = 0; j < k; j++) {
+                selected[j] |= table[i][j] & mask;
+            }
+        }
+        mul_ct(res.data(), res.data(), selected.data());
     }
+    return res;
+}
 
-    if (i == 0) return *this;
-
-    ll value = (ll)1 << (i);
-    value--; // set i bits to 1
-
-    int n = size();
+BigInteger MontgomeryContext::powModConstTime(const BigInteger &base, const BigInteger &e) const {
+    vector<TYPE> x(k), unit(k, 0);
+    to_montgomery_ct(x.data(), base);
+    vector<TYPE> res = powConstTime(x, e);
+    // multiplying by plain 1 divides by R, i.e. leaves Montgomery form
+    unit[0] = 1;
+    mul_ct(res.data(), res.data(), unit.data());
     BigInteger ans;
-    ans.sign = sign;
-    ans.digits.resize(n);
+    ans.setLimbs(res);
+    ans.trim();
+    return ans;
+}
+
+BigInteger MontgomeryContext::powMod(const BigInteger &base, const BigInteger &e) const {
+    // pow() on LimbVectors, so that the window table comes out of the arena under a ScratchScope
+    LimbVector x(k), unit = one;
+    to_montgomery(x.data(), base);
+    LimbVector res = sliding_window_pow(x, unit, e,
+                                        [this](LimbVector &r, const LimbVector &a) { mul(r.data(), r.data(), a.data()); },
+                                        [this](LimbVector &r) { sqr(r.data(), r.data()); });
+    return from_montgomery(res.data());
+}
 
-    int shilfS = i / BIT_PER_DIGIT;
-    // remove shilfS last digits    
-    for (int j = 0; j < n; j++) {
-        if (j + shilfS < n) {
-            ans.digits[j] = digits[j + shilfS];
+FixedBasePowContext::FixedBasePowContext(const BigInteger &base, const BigInteger &modulus, int maxExponentBits,
+                                         size_t memoryBudget) : ctx(modulus) {
+    max_bits = max(maxExponentBits, 1);
+    this->base = ctx.toMontgomery(base);
+
+    // pick the comb shape with the fewest weighted squarings (b) and multiplications
+    // (about v * b) whose v * 2^h entries fit the budget
+    size_t entry_bytes = ctx.limbs() * sizeof(TYPE);
+    size_t max_entries = max(memoryBudget / entry_bytes, (size_t)2);
+    double best = 1e18;
+    h = v = 1;
+    for (int hh = 1; hh <= 20 && ((size_t)1 << hh) <= max_entries; hh++) {
+        int aa = (max_bits + hh - 1) / hh;
+        for (int vv = 1; vv <= aa && (size_t)vv << hh <= max_entries; vv++) {
+            int bb = (aa + vv - 1) / vv;
+            double cost = 0.8 * bb + vv * bb * (1.0 - 1.0 / (1 << hh));
+            if (cost < best) {
+                best = cost;
+                h = hh;
+                v = vv;
+            }
+        }
+    }
+    a = (max_bits + h - 1) / h;
+    b = (a + v - 1) / v;
+
+    // powers[s][j] = base^(2^(j*a + s*b)), filled by repeated squaring
+    vector<vector<vector<TYPE>>> powers(v, vector<vector<TYPE>>(h));
+    vector<TYPE> x = this->base;
+    for (int j = 0; j < h; j++) {
+        for (int s = 0; s < v; s++) {
+            int start = j * a + s * b, end = min(j * a + (s + 1) * b, (j + 1) * a);
+            powers[s][j] = x;
+            for (int i = start; i < end; i++) {
+                ctx.sqr(x.data(), x.data());
+            }
         }
     }
-    
-    int shilf = i % BIT_PER_DIGIT;
-    ll carry = 0;
-    for (int j = n - 1; j >= 0; j--) {
-        ans.digits[j] = ans.digits[j] & (1ll << BIT_PER_DIGIT - 1);
-        if (j == n - 1) {
-            carry = digits[j] & value; // get the last i bits
-            ans.digits[j] = digits[j] >> shilf;
-        } else {
-            // n = n1{101} n2{010}
-            // n >> 1 = n1{10} n2{101}
 
-            ll temp = carry;
-            carry = digits[j] & value;
-            // put the last i bits of the previous number to the first i bits of the current number
-            ans.digits[j] = (digits[j] >> shilf) | (temp << (BIT_PER_DIGIT - shilf)); 
+    vector<TYPE> one = ctx.toMontgomery(BigInteger(1ll));
+    table.assign(v, vector<vector<TYPE>>(1 << h, one));
+    for (int s = 0; s < v; s++) {
+        for (int i = 1; i < (1 << h); i++) {
+            int top = 31 - __builtin_clz(i);
+            ctx.mul(table[s][i].data(), table[s][i ^ (1 << top)].data(), powers[s][top].data());
         }
     }
-    ans.trim();
-    return ans;
 }
 
-BigInteger BigInteger::operator<<(int i) {
-    if(i < 0) {
-        throw "Shift left must be positive";
+BigInteger FixedBasePowContext::powMod(const BigInteger &e) const {
+    if (e.bitLength() > max_bits) {
+        BigInteger res = ctx.fromMontgomery(ctx.pow(base, e.abs()));
+        return e.getSign() < 0 ? mod_inverse(res, ctx.modulus()) : res;
     }
-    
-    if (i == 0) return *this;
-    
-    int digitShift = i / BIT_PER_DIGIT; // number of digits to shift
-    int bitShift = i % BIT_PER_DIGIT; // number of bits to shift
-
-    BigInteger ans;
-    ans.sign = sign;
-    ans.digits.resize(digits.size() + digitShift + 1, 0);
-    
-    for (int j = 0; j < digits.size(); j++) {
-        // Apply the bit shift and mask to ensure values stay within BIT_PER_DIGIT bits
-        ll lower_part = (digits[j] << bitShift) & (BASE - 1);
-        ans.digits[j + digitShift] |= lower_part;
 
-        if (j + digitShift + 1 < ans.digits.size()) {
-            // Calculate the upper part that will spill over to the next digit
-            ll upper_part = digits[j] >> (BIT_PER_DIGIT - bitShift);
-            ans.digits[j + digitShift + 1] |= upper_part;
+    const LimbVector &y = e.getLimbs();
+    vector<TYPE> res = table[0][0];
+    for (int col = b - 1; col >= 0; col--) {
+        if (col != b - 1) {
+            ctx.sqr(res.data(), res.data());
+        }
+        for (int s = v - 1; s >= 0; s--) {
+            if (s * b + col >= a) continue;
+            int index = 0;
+            for (int j = 0; j < h; j++) {
+                index |= exponent_bit(y, j * a + s * b + col) << j;
+            }
+            if (index) {
+                ctx.mul(res.data(), res.data(), table[s][index].data());
+            }
         }
     }
 
-    ans.trim();
-    return ans;
+    BigInteger r = ctx.fromMontgomery(res);
+    return e.getSign() < 0 ? mod_inverse(r, ctx.modulus()) : r;
 }
 
-bool BigInteger::is_even() const {
-    return (digits[0] % 2 == 0);
+size_t FixedBasePowContext::tableBytes() const {
+    return (size_t)v * ((size_t)1 << h) * ctx.limbs() * sizeof(TYPE);
 }
 
-BigInteger BigInteger::operator%=(const BigInteger &a) {
-    *this = this->mod(a);
-    return *this;
+RsaPrivateKey::RsaPrivateKey(const BigInteger &p, const BigInteger &q, const BigInteger &e)
+        : p(p), q(q), ctx_p(p), ctx_q(q) {
+    if (p == q) {
+        throw "RSA primes must be distinct";
+    }
+    BigInteger one(1ll);
+    n = p * q;
+    this->e = e;
+    d = mod_inverse(e, lcm(p - one, q - one));
+    dp = d % (p - one);
+    dq = d % (q - one);
+    qInv = mod_inverse(q % p, p);
 }
 
-auto bezout(const BigInteger &x, const BigInteger &y) {
-    struct Ans {
-        BigInteger a, b;
-        BigInteger d; // Bezout => ax + by = gcd(x,y) = d
-    };
-
-    BigInteger temp_x, temp_y;
-
-    if (x.is_zero()) {
-        return Ans{BigInteger("0"), BigInteger("1"), y};
+RsaPrivateKey RsaPrivateKey::generate(int bits, const BigInteger &e, int threads) {
+    if (bits < 16) {
+        throw "RSA modulus too small";
+    }
+    // p - 1 is even for every odd prime, so an even e is never invertible and no retry would help
+    BigInteger one(1ll);
+    if (e.is_even() || e <= one) {
+        throw "RSA public exponent must be odd and greater than 1";
     }
-    if (y.is_zero()) {
-        return Ans{BigInteger("1"), BigInteger("0"), x};
+    while (true) {
+        BigInteger p = generate_large_prime(bits - bits / 2, threads);
+        BigInteger q = generate_large_prime(bits / 2, threads);
+        if (p == q || (p * q).bitLength() != bits) continue;
+        // e must be invertible mod lcm(p - 1, q - 1)
+        if (gcd(e, p - one) == one && gcd(e, q - one) == one) {
+            return RsaPrivateKey(p, q, e);
+        }
     }
+}
+
+const BigInteger &RsaPrivateKey::modulus() const {
+    return n;
+}
 
-    int sign_x = x.getSign();
-    int sign_y = y.getSign();
+const BigInteger &RsaPrivateKey::publicExponent() const {
+    return e;
+}
 
-    temp_x = x.abs();
-    temp_y = y.abs();
+const BigInteger &RsaPrivateKey::privateExponent() const {
+    return d;
+}
 
-    string x_binary = temp_x.toString();
-    string y_binary = temp_y.toString();
-    reverse(x_binary.begin(), x_binary.end());
-    reverse(y_binary.begin(), y_binary.end());
+BigInteger RsaPrivateKey::encrypt(const BigInteger &m) const {
+    return m.powMod(e, n);
+}
 
-    int g_count = 0;
-    int i = 0, j = 0;
+BigInteger RsaPrivateKey::decrypt(const BigInteger &c, bool parallel) const {
+    // the exponents are secret, so both halves use the branch-free fixed-window ladder
+    auto half = [&c](const MontgomeryContext &ctx, const BigInteger &exp) {
+        return ctx.powModConstTime(c, exp);
+    };
 
-    while (i < x_binary.size() && j < y_binary.size() && x_binary[i] == '0' && y_binary[i] == '0') {
-        g_count++;
-        i++;
-        j++;
+    BigInteger m1, m2;
+    if (parallel) {
+        // The worker builds its half in its own value: m1 may have been created under a
+        // ScratchScope of this thread, and writing it from the worker would allocate from this
+        // thread's arena. An exception escaping a thread would terminate, so it is carried over.
+        optional<BigInteger> r1;
+        exception_ptr error;
+        thread worker([&] {
+            try {
+                r1.emplace(half(ctx_p, dp));
+            } catch (...) {
+                error = current_exception();
+            }
+        });
+        try {
+            m2 = half(ctx_q, dq);
+        } catch (...) {
+            worker.join();
+            throw;
+        }
+        worker.join();
+        if (error) {
+            rethrow_exception(error);
+        }
+        m1 = std::move(*r1);
+    } else {
+        m1 = half(ctx_p, dp);
+        m2 = half(ctx_q, dq);
     }
 
-    temp_x = temp_x >> i;
+    // h = (m1 - m2) qInv mod p: m2 is folded mod p without a division and the difference is
+    // taken with the masked sub, so the sign of m1 - m2 never reaches a branch. A Montgomery
+    // product of x R with the plain qInv leaves Montgomery form on the way.
+    int kp = ctx_p.limbs(), kq = ctx_q.limbs();
+    LimbVector x(kp), y(kp), u = pad_limbs(qInv, kp);
+    ctx_p.to_montgomery_ct(x.data(), m1);
+    ctx_p.to_montgomery_ct(y.data(), m2);
+    ctx_p.sub(x.data(), x.data(), y.data());
+    ctx_p.mul_ct(x.data(), x.data(), u.data());
+
+    // m = m2 + h q < p q, by the schoolbook product whose loops depend only on the sizes
+    LimbVector m(kp + kq), v = pad_limbs(m2, kq);
+    mul_basecase(m.data(), x.data(), kp, q.getLimbs().data(), kq);
+    add_limbs(m.data(), m.data(), kp + kq, v.data(), kq);
+    BigInteger res;
+    res.setLimbs(std::move(m));
+    res.trim();
+    return res;
+}
+
+BigInteger RsaPrivateKey::sign(const BigInteger &m, bool parallel) const {
+    return decrypt(m, parallel);
+}
 
-    temp_y = temp_y >> j;
+BarrettContext::BarrettContext(const BigInteger &modulus) {
+    m = modulus.abs();
+    m.trim();
+    if (m.is_zero()) {
+        throw "Divide by zero";
+    }
+    k = m.bitLength();
+    mu = exact_reciprocal(m, k);
+}
 
-    BigInteger g = BigInteger("1") << g_count;
+const BigInteger &BarrettContext::modulus() const {
+    return m;
+}
 
-    BigInteger u(x);
-    BigInteger v(y);
+BigInteger BarrettContext::reduce(const BigInteger &x) const {
+    BigInteger r = x.abs();
+    if (r.bitLength() > 2 * k) {
+        r %= m;
+    } else {
+        // q underestimates floor(x / m) by at most 2 (HAC 14.42)
+        BigInteger q = ((r >> (k - 1)) * mu) >> (k + 1);
+        r -= q * m;
+        while (r >= m) {
+            r -= m;
+        }
+    }
+    if (x.getSign() < 0 && !r.is_zero()) {
+        r = m - r;
+    }
+    return r;
+}
 
-    BigInteger A("1");
-    BigInteger B("0");
-    BigInteger C("0");
-    BigInteger D("1");
+BigInteger BarrettContext::powMod(const BigInteger &base, const BigInteger &e) const {
+    return sliding_window_pow(reduce(base), reduce(BigInteger(1ll)), e,
+                              [this](BigInteger &r, const BigInteger &a) { r = reduce(r * a); },
+                              [this](BigInteger &r) { r = reduce(r.square()); });
+}
 
-    while (!u.is_zero()) {
-        while (!u.is_zero() && u.is_even()) {
-            u = u >> 1;
-            if (A.is_even() && B.is_even()) {
-                A = A >> 1;
-                B = B >> 1;
-            } else {
-                A = (A + y) >> 1;
-                // A %= y;
-                B = (B - x) >> 1;
-                // B %= y;
-            }
+BigInteger addMod(const BigInteger &a, const BigInteger &b, const BarrettContext &ctx) {
+    return ctx.reduce(a + b);
+}
 
-        }
+BigInteger mulMod(const BigInteger &a, const BigInteger &b, const BarrettContext &ctx) {
+    return ctx.reduce(a * b);
+}
 
-        while (!v.is_zero() && v.is_even()) {
-            v = v >> 1;
-            if (C.is_even() && D.is_even()) {
-                C = C >> 1;
-                D = D >> 1;
-            } else {
-                C = (C + y) >> 1;
-                // C %= y;
-                D = (D - x) >> 1;
-                // D %= y;
+// odd primes below SIEVE_LIMIT used to trial-divide prime candidates
+const int SIEVE_LIMIT = 1 << 15;
+const int SIEVE_WINDOW = 1 << 12; // odd candidates sieved per random start
+
+static const vector<int> &sieve_primes() {
+    static const vector<int> primes = [] {
+        vector<char> composite(SIEVE_LIMIT, 0);
+        vector<int> res;
+        for (int i = 3; i < SIEVE_LIMIT; i += 2) {
+            if (composite[i]) continue;
+            res.push_back(i);
+            for (ll j = (ll)i * i; j < SIEVE_LIMIT; j += 2 * i) {
+                composite[j] = 1;
             }
         }
+        return res;
+    }();
+    return primes;
+}
 
-        if (u >= v) {
-            u = u - v;
-            A = A - C;
-            B = B - D;
-        } else {
-            v = v - u;
-            C = C - A;
-            D = D - B;
-        }
+// x mod p for a small p, x >= 0
+static unsigned mod_small(const BigInteger &x, unsigned p) {
+    const LimbVector &d = x.getLimbs();
+    ull base_mod = (ull)(BASE % p), r = 0;
+    for (int i = (int)d.size() - 1; i >= 0; i--) {
+        r = (r * base_mod + (ull)d[i] % p) % p;
     }
+    return r;
+}
 
-    BigInteger a = C;
-    BigInteger b = D;
-    BigInteger d = v;
-    d = d * g;
+// uniform odd number of exactly `bits` bits
+static BigInteger random_odd(mt19937_64 &rng, int bits) {
+    LimbVector d((bits + BIT_PER_DIGIT - 1) / BIT_PER_DIGIT);
+    for (TYPE &x : d) {
+        x = rng();
+    }
+    int top = (bits - 1) % BIT_PER_DIGIT;
+    d.back() &= (1ull << top << 1) - 1;
+    d.back() |= 1ull << top;
+    d[0] |= 1;
+    BigInteger res;
+    res.setLimbs(std::move(d));
+    return res;
+}
 
-    a.setSign(a.getSign() * sign_x);
-    b.setSign(b.getSign() * sign_y);
+// one strong probable prime test of n, n - 1 = 2^s * d, to base a in Montgomery form
+static bool strong_probable_prime(const MontgomeryContext &ctx, const vector<TYPE> &a, const BigInteger &d, int s,
+                                  const vector<TYPE> &one, const vector<TYPE> &minus_one) {
+    vector<TYPE> x = ctx.pow(a, d);
+    if (x == one || x == minus_one) return true;
+    for (int j = 1; j < s; j++) {
+        ctx.sqr(x.data(), x.data());
+        if (x == one) return false;
+        if (x == minus_one) return true;
+    }
+    return false;
+}
 
-    return Ans{a, b, d};
+// Jacobi symbol (a / m) for small a and m, m odd and positive
+static int jacobi(ll a, ll m) {
+    int res = 1;
+    a %= m;
+    if (a < 0) a += m;
+    while (a) {
+        while (a % 2 == 0) {
+            a /= 2;
+            if ((m & 7) == 3 || (m & 7) == 5) res = -res;
+        }
+        swap(a, m);
+        if ((a & 3) == 3 && (m & 3) == 3) res = -res;
+        a %= m;
+    }
+    return m == 1 ? res : 0;
 }
 
-int msbPosition(ll x)
-{
-    int res = 0;
-    while (x > 0)
-    {
-        x >>= 1;
-        res++;
+// Jacobi symbol (a / n) for a small a and an odd n > 0
+static int jacobi(ll a, const BigInteger &n) {
+    int res = 1;
+    int n8 = n.getLimbs()[0] & 7;
+    if (a < 0) {
+        a = -a;
+        if ((n8 & 3) == 3) res = -res;
     }
-    return res;
+    if (a == 0) return 0;
+    while (a % 2 == 0) {
+        a /= 2;
+        if (n8 == 3 || n8 == 5) res = -res;
+    }
+    // reciprocity: (a / n) = (n / a) * (-1)^((a - 1) / 2 * (n - 1) / 2)
+    if ((a & 3) == 3 && (n8 & 3) == 3) res = -res;
+    return a == 1 ? res : res * jacobi((ll)mod_small(n, a), a);
 }
 
-auto divide(const BigInteger &a, const BigInteger &b) {
-    struct res {
-        BigInteger quotient;
-        BigInteger remainder;
-    };
-    
-    if (b.is_zero()) {
-        throw "Divide by zero";
+// floor(sqrt(n)) for n >= 0, by Newton iteration from above
+static BigInteger isqrt(const BigInteger &n) {
+    if (n.is_zero()) return n;
+    BigInteger x = BigInteger(1ll) << ((n.bitLength() + 1) / 2);
+    while (true) {
+        BigInteger y = (x + n / x) >> 1;
+        if (y >= x) return x;
+        x = y;
     }
+}
 
-    if (a.is_zero()) {
-        return res{BigInteger("0"), BigInteger("0")};
+// strong Lucas probable prime test with P = 1, Q = (1 - D) / 4, n + 1 = 2^s * d
+static bool strong_lucas_probable_prime(const MontgomeryContext &ctx, const BigInteger &n, ll D) {
+    int k = ctx.limbs();
+    BigInteger d = n + BigInteger(1ll);
+    int s = 0;
+    while (d.is_even()) {
+        d >>= 1;
+        s++;
     }
 
-    BigInteger x = a.abs();
-    BigInteger y = b.abs();
+    vector<TYPE> md = ctx.toMontgomery(BigInteger(D));
+    vector<TYPE> mq = ctx.toMontgomery(BigInteger((1 - D) / 4));
+    vector<TYPE> zero(k, 0), t(k);
+    vector<TYPE> u = ctx.toMontgomery(BigInteger(1ll)), v = u, qk = mq; // U_1, V_1 = P, Q^1
+
+    const LimbVector &y = d.getLimbs();
+    for (int i = d.bitLength() - 2; i >= 0; i--) {
+        // U_2j = U_j V_j, V_2j = V_j^2 - 2 Q^j
+        ctx.mul(u.data(), u.data(), v.data());
+        ctx.sqr(v.data(), v.data());
+        ctx.sub(v.data(), v.data(), qk.data());
+        ctx.sub(v.data(), v.data(), qk.data());
+        ctx.sqr(qk.data(), qk.data());
+        if (exponent_bit(y, i)) {
+            // U_j+1 = (P U_j + V_j) / 2, V_j+1 = (D U_j + P V_j) / 2
+            ctx.mul(t.data(), md.data(), u.data());
+            ctx.add(u.data(), u.data(), v.data());
+            ctx.half(u.data(), u.data());
+            ctx.add(v.data(), t.data(), v.data());
+            ctx.half(v.data(), v.data());
+            ctx.mul(qk.data(), qk.data(), mq.data());
+        }
+    }
 
-    int sign_x = a.getSign();
-    int sign_y = b.getSign();
+    if (u == zero || v == zero) return true;
+    for (int r = 1; r < s; r++) {
+        ctx.sqr(v.data(), v.data());
+        ctx.sub(v.data(), v.data(), qk.data());
+        ctx.sub(v.data(), v.data(), qk.data());
+        if (v == zero) return true;
+        ctx.sqr(qk.data(), qk.data());
+    }
+    return false;
+}
 
-    res answer;
-    answer.quotient = BigInteger("0");
-    answer.remainder = x;
+PrimalityResult primality_test(const BigInteger &n, const PrimalityOptions &options) {
+    BigInteger zero(0ll), one(1ll);
+    if (n.getSign() < 0 || n <= one) {
+        return {false, PrimalityReason::TooSmall, zero};
+    }
 
-    int n = x.size();
-    int m = y.size();
+    int Primes_size = sizeof(Primes) / sizeof(Primes[0]);
+    for (int i = 0; i < Primes_size; i++) {
+        if (mod_small(n, Primes[i])) continue;
+        if (n == BigInteger(Primes[i])) {
+            return {true, PrimalityReason::SmallPrime, zero};
+        }
+        return {false, PrimalityReason::SmallFactor, BigInteger(Primes[i])};
+    }
+    ll largest = Primes[Primes_size - 1];
+    if (n < BigInteger(largest * largest)) {
+        return {true, PrimalityReason::TrialDivision, zero};
+    }
 
-    if (x < y) { 
-        return res{BigInteger("0"), a};
+    // n - 1 = 2^s * d
+    BigInteger n_minus_1 = n - one;
+    BigInteger d = n_minus_1;
+    int s = 0;
+    while (d.is_even()) {
+        d >>= 1;
+        s++;
     }
 
-    while(answer.remainder >= b) {
-        
-        int msb_x = msbPosition(answer.remainder.getDigits().back());
-        int msb_y = msbPosition(y.getDigits().back());
-        int shift = msb_x - msb_y + (int)(answer.remainder.size() - y.size()) * BIT_PER_DIGIT;
+    MontgomeryContext ctx(n);
+    vector<TYPE> mont_one = ctx.toMontgomery(one);
+    vector<TYPE> minus_one = ctx.toMontgomery(n_minus_1);
+
+    // the first 12 primes are a deterministic base set below 3.18 * 10^23 > 2^78
+    if (n.bitLength() <= 78) {
+        for (int i = 0; i < 12; i++) {
+            BigInteger a(Primes[i]);
+            if (!strong_probable_prime(ctx, ctx.toMontgomery(a), d, s, mont_one, minus_one)) {
+                return {false, PrimalityReason::MillerRabin, a};
+            }
+        }
+        return {true, PrimalityReason::Passed, zero};
+    }
 
-        BigInteger shifted_y = y << shift;
+    BigInteger two(2ll);
+    if (!strong_probable_prime(ctx, ctx.toMontgomery(two), d, s, mont_one, minus_one)) {
+        return {false, PrimalityReason::MillerRabin, two};
+    }
 
-        while (answer.remainder < shifted_y) {
-            shift--;
-            shifted_y = y << shift;
+    // Selfridge's method A: the first D in 5, -7, 9, -11, ... with (D / n) = -1; none
+    // exists for squares, so test for one once the search runs long
+    ll D = 5;
+    for (int i = 0;; i++) {
+        int j = jacobi(D, n);
+        if (j == -1) break;
+        if (j == 0) {
+            return {false, PrimalityReason::SmallFactor, BigInteger(D < 0 ? -D : D)};
+        }
+        if (i == 10) {
+            BigInteger r = isqrt(n);
+            if (r * r == n) {
+                return {false, PrimalityReason::PerfectSquare, r};
+            }
         }
-                
-        answer.remainder = answer.remainder - shifted_y;
-        answer.quotient = answer.quotient + (BigInteger("1") << shift);
+        D = D > 0 ? -(D + 2) : -(D - 2);
     }
-    
-    if(answer.quotient.is_zero()) {
-        answer.quotient = BigInteger("0");
+    if (!strong_lucas_probable_prime(ctx, n, D)) {
+        return {false, PrimalityReason::Lucas, zero};
     }
-    else {
-        answer.quotient.setSign(sign_x * sign_y);
+
+    // optional extra rounds with uniform bases in [2, n - 2]
+    mt19937_64 local(options.seed);
+    mt19937_64 &rng = options.rng ? *options.rng : local;
+    BigInteger range = n - BigInteger(3ll);
+    for (int i = 0; i < options.rounds; i++) {
+        LimbVector limbs(ctx.limbs() + 1);
+        for (TYPE &x : limbs) {
+            x = rng();
+        }
+        BigInteger a;
+        a.setLimbs(std::move(limbs));
+        a.trim();
+        a %= range;
+        a += two;
+        if (!strong_probable_prime(ctx, ctx.toMontgomery(a), d, s, mont_one, minus_one)) {
+            return {false, PrimalityReason::MillerRabin, a};
+        }
     }
-    answer.remainder.setSign(sign_x);
 
-    return answer;
+    return {true, PrimalityReason::Passed, zero};
 }
 
-BigInteger lcm(const BigInteger &x, const BigInteger &y) {
-    BigInteger temp_x(x), temp_y(y);
-    BigInteger xy = temp_x * temp_y;
-    BigInteger gcd = bezout(x, y).d;
-    return divide(xy, gcd).quotient;
+bool is_probable_prime(const BigInteger &n, int rounds, mt19937_64 *rng) {
+    PrimalityOptions options;
+    options.rounds = rounds;
+    options.rng = rng;
+    return primality_test(n, options).probablePrime;
 }
 
 bool Miller_Rabin_check(const BigInteger &n) {
-    if (n.is_even()) return false;
-
-    // n - 1 = 2^s . d
-    BigInteger d = n - BigInteger("1");
-    int s = 0;
-    while (d.is_even()) {
-        d = d >> 1;
-        s++;
-    }
-
-    BigInteger n_minus_1 = n - BigInteger("1");
-    srand(time(0));
-
-    int Primes_size = sizeof(Primes) / sizeof(Primes[0]);
+    return primality_test(n).probablePrime;
+}
 
-    for (int i = 0; i < 5; i++) {
-        BigInteger a((ll)Primes[rand() % Primes_size]);
+const int BATCH_MIN_BITS = 1024; // must stay above log2(SIEVE_LIMIT)
+const size_t BATCH_CHUNK = 64;
+
+// product of the odd primes below SIEVE_LIMIT and 2, built with a product tree
+static const BigInteger &sieve_primorial() {
+    static const BigInteger primorial = [] {
+        // the cached value outlives any scratch scope of the first caller
+        LimbResourceScope heap(nullptr);
+        vector<BigInteger> level{BigInteger(2ll)};
+        for (int p : sieve_primes()) {
+            level.push_back(BigInteger(p));
+        }
+        while (level.size() > 1) {
+            vector<BigInteger> next;
+            for (size_t i = 0; i + 1 < level.size(); i += 2) {
+                next.push_back(level[i] * level[i + 1]);
+            }
+            if (level.size() % 2) next.push_back(level.back());
+            level.swap(next);
+        }
+        return level[0];
+    }();
+    return primorial;
+}
 
-        BigInteger x = a.powMod(d, n);
+// P mod n for every n of the group, where P is sieve_primorial(): build the product tree
+// of the group, reduce P modulo the root and push the remainders down to the leaves
+static vector<BigInteger> primorial_remainders(const vector<BigInteger> &group) {
+    vector<vector<BigInteger>> tree{group};
+    while (tree.back().size() > 1) {
+        const vector<BigInteger> &level = tree.back();
+        vector<BigInteger> next;
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            next.push_back(level[i] * level[i + 1]);
+        }
+        if (level.size() % 2) next.push_back(level.back());
+        tree.push_back(next);
+    }
 
-        if (x == BigInteger("1") || x == n_minus_1) continue;
+    vector<BigInteger> rem{sieve_primorial() % tree.back()[0]};
+    for (int d = (int)tree.size() - 2; d >= 0; d--) {
+        vector<BigInteger> next(tree[d].size());
+        for (size_t i = 0; i < next.size(); i++) {
+            next[i] = rem[i / 2] % tree[d][i];
+        }
+        rem.swap(next);
+    }
+    return rem;
+}
 
-        bool check = false;
+vector<bool> batch_is_probable_prime(span<const BigInteger> candidates, int threads) {
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
 
-        for (int j = 1; j < s; j++) {
-            x = x.mulMod(x, n);
-            if (x == BigInteger("1")) return false;
-            if (x == n_minus_1) {
-                check = true;
-                break;
+    // large candidates are grouped so that a group's product is about the size of the
+    // primorial; below BATCH_MIN_BITS a single Miller-Rabin test is cheaper than the tree,
+    // so those go in plain chunks of BATCH_CHUNK
+    struct Group {
+        vector<size_t> index;
+        bool sieve;
+    };
+    int group_bits = sieve_primorial().bitLength();
+    vector<Group> groups;
+    Group large{{}, true}, small{{}, false};
+    int bits = 0;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const BigInteger &n = candidates[i];
+        if (n.getSign() < 0 || n.bitLength() < BATCH_MIN_BITS) {
+            small.index.push_back(i);
+            if (small.index.size() == BATCH_CHUNK) {
+                groups.push_back(std::move(small));
+                small = {{}, false};
             }
+            continue;
+        }
+        large.index.push_back(i);
+        bits += n.bitLength();
+        if (bits >= group_bits) {
+            groups.push_back(std::move(large));
+            large = {{}, true};
+            bits = 0;
         }
-        if (!check) return false;
     }
+    if (!small.index.empty()) groups.push_back(std::move(small));
+    if (!large.index.empty()) groups.push_back(std::move(large));
+
+    vector<char> res(candidates.size(), 0);
+    atomic<size_t> next_group(0);
+    auto worker = [&] {
+        BigInteger one(1ll);
+        for (size_t g; (g = next_group++) < groups.size();) {
+            const Group &group = groups[g];
+            if (!group.sieve) {
+                for (size_t i : group.index) {
+                    res[i] = primality_test(candidates[i]).probablePrime;
+                }
+                continue;
+            }
+
+            vector<BigInteger> values;
+            for (size_t i : group.index) {
+                values.push_back(candidates[i]);
+            }
+            vector<BigInteger> rem = primorial_remainders(values);
+            for (size_t j = 0; j < values.size(); j++) {
+                if (gcd(values[j], rem[j]) != one) continue;
+                res[group.index[j]] = primality_test(values[j]).probablePrime;
+            }
+        }
+    };
 
-    return true;
+    vector<thread> workers;
+    for (int i = 1; i < min(threads, (int)groups.size()); i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (thread &t : workers) {
+        t.join();
+    }
+    return vector<bool>(res.begin(), res.end());
 }
 
 string hex_to_bin(const string &hex) {
@@ -751,47 +3583,366 @@ string hex_to_bin(const string &hex) {
     return binary;
 }
 
-BigInteger generate_large_prime(int bit_length)
+// Sieves the window of odd candidates after one random start of bit_length bits and runs
+// Miller-Rabin on the survivors. Returns false if the window holds no probable prime or
+// *stop was raised meanwhile.
+static bool sieve_search(mt19937_64 &rng, int bit_length, BigInteger &res, const atomic<bool> *stop) {
+    // only sieve with primes below every candidate, so a small prime is never struck out
+    const vector<int> &primes = sieve_primes();
+    int count = bit_length > 16 ? primes.size()
+                                : lower_bound(primes.begin(), primes.end(), 1 << (bit_length - 1)) - primes.begin();
+    BigInteger limit = BigInteger(1ll) << bit_length;
+    static thread_local vector<char> composite;
+    composite.assign(SIEVE_WINDOW, 0);
+
+    // candidates are start + 2j; residues of start are computed once per window, and
+    // each prime strikes out every p-th candidate from the first multiple onwards
+    BigInteger start = random_odd(rng, bit_length);
+    for (int i = 0; i < count; i++) {
+        ull p = primes[i];
+        ull j = (p - mod_small(start, p)) % p * ((p + 1) / 2) % p;
+        for (; j < SIEVE_WINDOW; j += p) {
+            composite[j] = 1;
+        }
+    }
+
+    for (int j = 0; j < SIEVE_WINDOW; j++) {
+        if (composite[j]) continue;
+        if (stop && stop->load(memory_order_relaxed)) return false;
+        BigInteger n = start + BigInteger(2ll * j);
+        if (n >= limit) return false;
+        if (Miller_Rabin_check(n)) {
+            res = n;
+            return true;
+        }
+    }
+    return false;
+}
+
+BigInteger generate_large_prime(int bit_length, int threads)
 {
-    std::mt19937_64 rng(std::random_device{}()); 
-    std::uniform_int_distribution<uint64_t> dist(0, 1); 
-    
+    if (bit_length < 2) {
+        throw "Bit length too small";
+    }
+    if (threads != 1) {
+        return generate_large_primes(bit_length, 1, threads)[0];
+    }
+
+    std::mt19937_64 rng(std::random_device{}());
     BigInteger n;
-    do {
-        string binary = "1";
-        for (int i = 1; i < bit_length - 1; i++) {
-            binary += std::to_string(dist(rng)); 
+    while (!sieve_search(rng, bit_length, n, nullptr));
+    return n;
+}
+
+vector<BigInteger> generate_large_primes(int bit_length, int count, int threads)
+{
+    if (bit_length < 2) {
+        throw "Bit length too small";
+    }
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+
+    vector<BigInteger> res;
+    if (count <= 0) return res;
+    mutex res_mutex;
+    atomic<bool> done(false);
+
+    // every worker searches its own random windows with its own generator; the first
+    // `count` distinct primes found win and raise `done` for the rest
+    auto worker = [&](mt19937_64 rng) {
+        BigInteger p;
+        while (!done.load(memory_order_relaxed)) {
+            if (!sieve_search(rng, bit_length, p, &done)) continue;
+            lock_guard<mutex> lock(res_mutex);
+            if ((int)res.size() < count && find(res.begin(), res.end(), p) == res.end()) {
+                res.push_back(p);
+                if ((int)res.size() == count) {
+                    done = true;
+                }
+            }
         }
-        binary += "1";
-        n = BigInteger(binary);
-    } while (!Miller_Rabin_check(n));
+    };
 
-    return n;
+    random_device rd;
+    vector<thread> workers;
+    for (int i = 1; i < threads; i++) {
+        seed_seq seed{rd(), rd(), (unsigned)i};
+        workers.emplace_back(worker, mt19937_64(seed));
+    }
+    seed_seq seed{rd(), rd(), 0u};
+    worker(mt19937_64(seed));
+    for (thread &t : workers) {
+        t.join();
+    }
+    return res;
 }
 
 BigInteger mod_inverse(const BigInteger &a, const BigInteger &n)
 {
-    // based on the Extended Euclidean Algorithm
-    // ax + ny = d which is the gcd of a and n, in this case d must be 1
-    // so ax + ny = 1 => ax = 1 (mod n) => x is the modular inverse of a
+    // Lehmer's extended Euclid on (n, a mod n), tracking only the cofactor x of a in
+    // x a + y n = gcd(a, n), which must be 1
+    BigInteger inv;
+    ScratchScope scratch;
+    BigInteger abs_n = n.abs();
+    BigInteger r = a % abs_n;
+    if (r.getSign() < 0) {
+        r += abs_n;
+    }
 
-    auto ans = bezout(a, n);
-    
-    if (ans.d != BigInteger("1")) {
+    BigInteger x;
+    if (gcd_abs(abs_n, r, &x, true) != BigInteger(1ll)) {
         throw "Modular inverse does not exist";
     }
 
-    BigInteger x = ans.a;
+    x %= abs_n;
+    if (x.getSign() < 0) {
+        x += abs_n;
+    }
+    inv = x;
+    return inv;
+}
+
+// Bernstein-Yang safegcd, laid out like libsecp256k1's modinv64: numbers are little-endian
+// arrays of 62-bit limbs whose top limb carries the sign, and every 59 divsteps are
+// applied as one 2x2 transition matrix scaled by 2^62
+const int DIVSTEP_BITS = 62;
+const ll DIVSTEP_MASK = (1ll << DIVSTEP_BITS) - 1;
+
+static vector<ll> to_divstep_limbs(const BigInteger &x, int limbs) {
+    vector<ll> res(limbs);
+    for (int i = 0; i < limbs; i++) {
+        res[i] = leading_bits(x, i * DIVSTEP_BITS);
+    }
+    return res;
+}
+
+static BigInteger from_divstep_limbs(const vector<ll> &x) {
+    LimbVector d;
+    u128 buf = 0;
+    int bits = 0;
+    for (ll limb : x) {
+        buf |= (u128)(ull)limb << bits;
+        bits += DIVSTEP_BITS;
+        while (bits >= BIT_PER_DIGIT) {
+            d.push_back((TYPE)buf);
+            buf >>= BIT_PER_DIGIT;
+            bits -= BIT_PER_DIGIT;
+        }
+    }
+    d.push_back((TYPE)buf);
+    BigInteger res;
+    res.setLimbs(std::move(d));
+    res.trim();
+    return res;
+}
 
-    BigInteger y = ans.b;
+// 59 branch-free divsteps on the low bits of f (odd) and g, with zeta = -(delta + 1/2);
+// returns the new zeta and the transition matrix [[u, v], [q, r]] scaled by 2^62
+static ll divsteps_59(ll zeta, ull f, ull g, ll &tu, ll &tv, ll &tq, ll &tr) {
+    ull u = 8, v = 0, q = 0, r = 8;
+    for (int i = 3; i < DIVSTEP_BITS; i++) {
+        ull neg = (ull)(zeta >> 63);  // zeta < 0
+        ull odd = -(g & 1);           // g odd
+        ull x = (f ^ neg) - neg, y = (u ^ neg) - neg, z = (v ^ neg) - neg;
+        g += x & odd;
+        q += y & odd;
+        r += z & odd;
+        neg &= odd;
+        zeta = (zeta ^ (ll)neg) - 1;
+        f += g & neg;
+        u += q & neg;
+        v += r & neg;
+        g >>= 1;
+        u <<= 1;
+        v <<= 1;
+    }
+    tu = (ll)u, tv = (ll)v, tq = (ll)q, tr = (ll)r;
+    return zeta;
+}
 
-    BigInteger d = ans.d;
+// (f, g) = (u f + v g, q f + r g) / 2^62, which is exact
+static void divstep_update_fg(vector<ll> &f, vector<ll> &g, ll u, ll v, ll q, ll r) {
+    int n = f.size();
+    __int128 cf = (__int128)u * f[0] + (__int128)v * g[0];
+    __int128 cg = (__int128)q * f[0] + (__int128)r * g[0];
+    cf >>= DIVSTEP_BITS;
+    cg >>= DIVSTEP_BITS;
+    for (int i = 1; i < n; i++) {
+        cf += (__int128)u * f[i] + (__int128)v * g[i];
+        cg += (__int128)q * f[i] + (__int128)r * g[i];
+        f[i - 1] = (ll)cf & DIVSTEP_MASK;
+        g[i - 1] = (ll)cg & DIVSTEP_MASK;
+        cf >>= DIVSTEP_BITS;
+        cg >>= DIVSTEP_BITS;
+    }
+    f[n - 1] = (ll)cf;
+    g[n - 1] = (ll)cg;
+}
 
-    if (x.getSign() == -1) {
-        x = x + n;
+// (d, e) = (u d + v e, q d + r e) / 2^62 mod m, keeping both in (-2m, m): multiples of m
+// chosen from the low limbs make the sums divisible by 2^62
+static void divstep_update_de(vector<ll> &d, vector<ll> &e, ll u, ll v, ll q, ll r,
+                              const vector<ll> &m, ull m_inv) {
+    int n = d.size();
+    ll sd = d[n - 1] >> 63, se = e[n - 1] >> 63;
+    ll md = (u & sd) + (v & se);
+    ll me = (q & sd) + (r & se);
+    __int128 cd = (__int128)u * d[0] + (__int128)v * e[0];
+    __int128 ce = (__int128)q * d[0] + (__int128)r * e[0];
+    md -= (ll)((m_inv * (ull)cd + (ull)md) & DIVSTEP_MASK);
+    me -= (ll)((m_inv * (ull)ce + (ull)me) & DIVSTEP_MASK);
+    cd += (__int128)m[0] * md;
+    ce += (__int128)m[0] * me;
+    cd >>= DIVSTEP_BITS;
+    ce >>= DIVSTEP_BITS;
+    for (int i = 1; i < n; i++) {
+        cd += (__int128)u * d[i] + (__int128)v * e[i] + (__int128)m[i] * md;
+        ce += (__int128)q * d[i] + (__int128)r * e[i] + (__int128)m[i] * me;
+        d[i - 1] = (ll)cd & DIVSTEP_MASK;
+        e[i - 1] = (ll)ce & DIVSTEP_MASK;
+        cd >>= DIVSTEP_BITS;
+        ce >>= DIVSTEP_BITS;
     }
+    d[n - 1] = (ll)cd;
+    e[n - 1] = (ll)ce;
+}
 
-    return x;
+// x = sign * x mod m in [0, m) for x in (-2m, m), without branching on x
+static void divstep_normalize(vector<ll> &x, ll sign, const vector<ll> &m) {
+    int n = x.size();
+    auto carry = [&] {
+        for (int i = 0; i + 1 < n; i++) {
+            x[i + 1] += x[i] >> DIVSTEP_BITS;
+            x[i] &= DIVSTEP_MASK;
+        }
+    };
+    ll add = x[n - 1] >> 63;
+    for (int i = 0; i < n; i++) {
+        x[i] += m[i] & add;
+    }
+    ll negate = sign >> 63;
+    for (int i = 0; i < n; i++) {
+        x[i] = (x[i] ^ negate) - negate;
+    }
+    carry();
+    add = x[n - 1] >> 63;
+    for (int i = 0; i < n; i++) {
+        x[i] += m[i] & add;
+    }
+    carry();
+}
+
+BigInteger mod_inverse_consttime(const BigInteger &a, const BigInteger &n)
+{
+    if (n.getSign() < 0 || n.is_even()) {
+        throw "Constant-time inverse needs an odd positive modulus";
+    }
+    // a is secret, so it is not reduced here: a division and a sign fix-up would both depend on
+    // its value. The range check subtracts n over all of its limbs and looks only at the borrow.
+    int k = n.getLimbs().size();
+    if (a.getSign() < 0 || (int)a.getLimbs().size() > k) {
+        throw "Constant-time inverse needs 0 <= a < n";
+    }
+    LimbVector x = pad_limbs(a, k);
+    TYPE borrow = 0;
+    for (int i = 0; i < k; i++) {
+        sub_borrow(x[i], n.getLimbs()[i], borrow);
+    }
+    if (!borrow) {
+        throw "Constant-time inverse needs 0 <= a < n";
+    }
+
+    int bits = n.bitLength();
+    int limbs = bits / DIVSTEP_BITS + 2;
+    vector<ll> m = to_divstep_limbs(n, limbs), f = m, g = to_divstep_limbs(a, limbs);
+    vector<ll> d(limbs, 0), e(limbs, 0);
+    e[0] = 1;
+
+    // m^-1 mod 2^62 by Newton iteration, each step doubling the correct low bits
+    ull m_inv = (ull)m[0];
+    for (int i = 0; i < 6; i++) {
+        m_inv *= 2 - (ull)m[0] * m_inv;
+    }
+
+    // f = d x and g = e x (mod n) throughout; the divstep count bound from the safegcd
+    // paper guarantees g = 0 and f = +-gcd(x, n) at the end
+    int divsteps = bits < 46 ? (49 * bits + 80) / 17 : (49 * bits + 57) / 17;
+    ll zeta = -1;
+    for (int i = 0; i < divsteps; i += DIVSTEP_BITS - 3) {
+        ll u, v, q, r;
+        zeta = divsteps_59(zeta, f[0], g[0], u, v, q, r);
+        divstep_update_de(d, e, u, v, q, r, m, m_inv);
+        divstep_update_fg(f, g, u, v, q, r);
+    }
+
+    bool plus_one = f[0] == 1, minus_one = f[0] == DIVSTEP_MASK && f[limbs - 1] == -1;
+    for (int i = 1; i + 1 < limbs; i++) {
+        plus_one &= f[i] == 0;
+        minus_one &= f[i] == DIVSTEP_MASK;
+    }
+    plus_one &= f[limbs - 1] == 0;
+    if (!plus_one && !minus_one) {
+        throw "Modular inverse does not exist";
+    }
+
+    divstep_normalize(d, f[limbs - 1], m);
+    return from_divstep_limbs(d);
+}
+
+// Montgomery's trick over any representation: inverts every x[i] with one call to inv and
+// 3(N - 1) calls to mul, through the prefix products x[0] ... x[i]
+template <class T, class Mul, class Inv>
+static vector<T> batch_invert(const vector<T> &x, Mul mul, Inv inv) {
+    vector<T> prefix(x.size()), res(x.size());
+    prefix[0] = x[0];
+    for (size_t i = 1; i < x.size(); i++) {
+        prefix[i] = mul(prefix[i - 1], x[i]);
+    }
+    T acc = inv(prefix.back()); // (x[0] ... x[i])^-1
+    for (size_t i = x.size() - 1; i > 0; i--) {
+        res[i] = mul(acc, prefix[i - 1]);
+        acc = mul(acc, x[i]);
+    }
+    res[0] = acc;
+    return res;
+}
+
+vector<BigInteger> mod_inverse_batch(const vector<BigInteger> &a, const BigInteger &n)
+{
+    if (a.empty()) return {};
+    BigInteger abs_n = n.abs();
+
+    if (!abs_n.is_even() && abs_n > BigInteger(1ll)) {
+        // products stay in Montgomery form; the prefix inverse is taken on the plain value
+        MontgomeryContext ctx(abs_n);
+        vector<vector<TYPE>> x;
+        for (const BigInteger &v : a) {
+            x.push_back(ctx.toMontgomery(v));
+        }
+        auto mul = [&ctx](const vector<TYPE> &p, const vector<TYPE> &q) {
+            vector<TYPE> r(p.size());
+            ctx.mul(r.data(), p.data(), q.data());
+            return r;
+        };
+        auto inv = [&](const vector<TYPE> &p) {
+            return ctx.toMontgomery(mod_inverse(ctx.fromMontgomery(p), abs_n));
+        };
+        vector<BigInteger> res;
+        for (const vector<TYPE> &v : batch_invert(x, mul, inv)) {
+            res.push_back(ctx.fromMontgomery(v));
+        }
+        return res;
+    }
+
+    BarrettContext ctx(abs_n);
+    vector<BigInteger> x;
+    for (const BigInteger &v : a) {
+        x.push_back(ctx.reduce(v));
+    }
+    auto mul = [&ctx](const BigInteger &p, const BigInteger &q) { return mulMod(p, q, ctx); };
+    auto inv = [&abs_n](const BigInteger &p) { return mod_inverse(p, abs_n); };
+    return batch_invert(x, mul, inv);
 }
 
 string string_to_binary(const string &s)
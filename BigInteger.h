@@ -18,14 +18,33 @@ and the divide function, which divides two integers.
 #include <chrono>
 #include <random>
 #include <bitset>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <span>
+#include <string_view>
+#include <cstdint>
+#include <memory_resource>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
 using namespace std;
 
 #define ll long long
-const int BIT_PER_DIGIT = 61;
-const ll BASE = 1ll << BIT_PER_DIGIT;
+#define ull unsigned long long
+// limbs are full 64-bit words, i.e. digits in radix BASE = 2^64
+const int BIT_PER_DIGIT = 64;
 
-using TYPE = ll;
+// digit width of the original 61-bit representation, kept for setDigits / getDigits
+const int LEGACY_BIT_PER_DIGIT = 61;
+
+using TYPE = ull;
+using u128 = unsigned __int128;
+
+const u128 BASE = (u128)1 << BIT_PER_DIGIT;
 
 int Primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29,
                 31, 37, 41, 43, 47, 53, 59, 61, 67, 71,
@@ -38,11 +57,182 @@ int Primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29,
                 419, 421, 431, 433, 439, 443, 449, 457, 461, 463,
                 467, 479, 487, 491, 499, 503, 509, 521, 523, 541};
 
+// Operand sizes (in limbs) from which operator* and square() switch to Karatsuba,
+// Toom-3 and the NTT. The defaults are conservative, tune_multiply.cpp measures them for the host.
+struct MultiplyThresholds {
+    int karatsuba = 32;
+    int toom3 = 96;
+    int ntt = 1600;
+};
+
+void setMultiplyThresholds(const MultiplyThresholds &t);
+
+MultiplyThresholds getMultiplyThresholds();
+
+// word order of byte import and export, as in mpz_import / mpz_export
+enum class ByteOrder {BigEndian, LittleEndian};
+
+// limbs a BigInteger keeps in place before spilling to the heap (8 limbs = 512 bits)
+#ifndef BIGINT_INLINE_LIMBS
+#define BIGINT_INLINE_LIMBS 8
+#endif
+
+// bytes of scratch memory an idle thread keeps for its next ScratchScope (1 MB)
+#ifndef BIGINT_SCRATCH_RETAIN_BYTES
+#define BIGINT_SCRATCH_RETAIN_BYTES (1 << 20)
+#endif
+
+// vector-like limb storage with small-buffer optimization: up to INLINE_LIMBS limbs live
+// inside the object, so small values never touch the allocator. Larger blocks come from the
+// memory resource that was current on the thread when the vector was created (see ScratchScope);
+// like std::pmr containers, moves only hand over blocks between vectors on the same resource.
+class LimbVector {
+public:
+    static const uint32_t INLINE_LIMBS = BIGINT_INLINE_LIMBS;
+
+    LimbVector() : ptr(buf), len(0), cap(INLINE_LIMBS), res(current) {}
+
+    explicit LimbVector(size_t n, TYPE value = 0);
+
+    LimbVector(const TYPE *first, const TYPE *last);
+
+    LimbVector(const LimbVector &other);
+
+    LimbVector(LimbVector &&other) noexcept;
+
+    LimbVector &operator=(const LimbVector &other);
+
+    LimbVector &operator=(LimbVector &&other); // copies when other uses a different resource
+
+    ~LimbVector();
+
+    size_t size() const { return len; }
+
+    bool empty() const { return len == 0; }
+
+    size_t capacity() const { return cap; }
+
+    bool is_inline() const { return ptr == buf; }
+
+    TYPE *data() { return ptr; }
+
+    const TYPE *data() const { return ptr; }
+
+    TYPE *begin() { return ptr; }
+
+    TYPE *end() { return ptr + len; }
+
+    const TYPE *begin() const { return ptr; }
+
+    const TYPE *end() const { return ptr + len; }
+
+    TYPE &operator[](size_t i) { return ptr[i]; }
+
+    const TYPE &operator[](size_t i) const { return ptr[i]; }
+
+    TYPE &back() { return ptr[len - 1]; }
+
+    const TYPE &back() const { return ptr[len - 1]; }
+
+    void clear() { len = 0; }
+
+    void pop_back() { len--; }
+
+    void push_back(TYPE x) {
+        if (len == cap) grow(len + 1);
+        ptr[len++] = x;
+    }
+
+    void resize(size_t n, TYPE value = 0) {
+        if (n > cap) grow(n);
+        if (n > len) fill(ptr + len, ptr + n, value);
+        len = (uint32_t)n;
+    }
+
+    void reserve(size_t n) {
+        if (n > cap) grow(n);
+    }
+
+    void assign(const TYPE *first, const TYPE *last);
+
+    bool operator==(const LimbVector &a) const { return len == a.len && equal(ptr, ptr + len, a.ptr); }
+
+    // a copy as the vector<TYPE> the limbs used to be stored in, e.g. vector<TYPE>(x.getLimbs())
+    explicit operator vector<TYPE>() const { return vector<TYPE>(ptr, ptr + len); }
+
+    // resource new vectors on this thread draw from, never nullptr
+    static std::pmr::memory_resource *resource() { return current ? current : std::pmr::new_delete_resource(); }
+
+private:
+    TYPE *ptr;      // buf, or a block of cap limbs from res
+    uint32_t len;
+    uint32_t cap;
+    std::pmr::memory_resource *res; // nullptr for the global heap
+    TYPE buf[INLINE_LIMBS];
+
+    // resource for vectors created on this thread, set by LimbResourceScope and ScratchScope
+    static inline thread_local std::pmr::memory_resource *current = nullptr;
+
+    void grow(size_t n); // reallocate to hold at least n limbs, keeping the contents
+
+    void release();
+
+    friend class LimbResourceScope;
+    friend class ScratchScope;
+};
+
+// Routes the limb storage of BigIntegers created on this thread to resource (nullptr for the
+// global heap) until the scope ends. Values that must outlive the resource should be assigned
+// to BigIntegers created before the scope: assignment copies into their own storage, while
+// move-constructing from a value made inside the scope keeps the scope's memory.
+class LimbResourceScope {
+public:
+    explicit LimbResourceScope(std::pmr::memory_resource *resource);
+
+    ~LimbResourceScope();
+
+    LimbResourceScope(const LimbResourceScope &) = delete;
+
+    LimbResourceScope &operator=(const LimbResourceScope &) = delete;
+
+private:
+    std::pmr::memory_resource *previous;
+};
+
+// Draws the limbs of everything created on this thread from a thread-local bump arena, with
+// at least reserveLimbs limbs set aside up front. The outermost scope frees it all at once on
+// exit; the arena keeps one block, grown to the high-water mark but at most
+// BIGINT_SCRATCH_RETAIN_BYTES, so later scopes of that size run without allocator calls.
+// Nested scopes share the outer one. The same lifetime rule as for LimbResourceScope applies.
+// The arena is not synchronized, so values with arena storage must stay on this thread: in
+// particular, no other thread may assign to a BigInteger created under the scope, since
+// growing its limbs would allocate from this thread's arena. Let the other thread fill its
+// own value and assign that here after join().
+class ScratchScope {
+public:
+    explicit ScratchScope(size_t reserveLimbs = 0);
+
+    ~ScratchScope();
+
+    ScratchScope(const ScratchScope &) = delete;
+
+    ScratchScope &operator=(const ScratchScope &) = delete;
+
+    static void releaseMemory(); // frees the block this thread keeps; no effect inside a scope
+
+private:
+    std::pmr::memory_resource *previous;
+    bool owner; // the outermost scope on this thread
+};
+
 class BigInteger {
 private:
-    vector<TYPE> digits;
+    LimbVector digits;
     int sign;
 
+    // r = x + y_sign * |y|; r may be x or y
+    static void add_signed(BigInteger &r, const BigInteger &x, const BigInteger &y, int y_sign);
+
 public:
     BigInteger();
 
@@ -50,19 +240,36 @@ public:
 
     BigInteger(const string  &s, int base, int sign);
 
-    BigInteger(TYPE l);
+    BigInteger(ll l);
 
     BigInteger(const BigInteger &other);
 
+    BigInteger(BigInteger &&other) noexcept;
+
+    BigInteger &operator=(const BigInteger &other); // reuses the limb storage when it is big enough
+
+    BigInteger &operator=(BigInteger &&other);
+
     void trim();
 
     BigInteger abs() const;
 
-    void setDigits(const vector<TYPE> &digit);
+    void setLimbs(const vector<TYPE> &limbs); // little-endian 64-bit limbs of |x|
+
+    void setLimbs(const LimbVector &limbs);
+
+    void setLimbs(LimbVector &&limbs); // takes over the storage
 
     void setSign(int s);
 
-    const vector<TYPE> &getDigits() const;
+    const LimbVector &getLimbs() const;
+
+    // the pre-2^64 interface: little-endian digits of |x| in radix 2^LEGACY_BIT_PER_DIGIT
+    [[deprecated("digits are 61-bit; use setLimbs for 64-bit limbs")]]
+    void setDigits(const vector<TYPE> &digit);
+
+    [[deprecated("digits are 61-bit; use getLimbs for 64-bit limbs")]]
+    vector<TYPE> getDigits() const;
 
     int getSign() const;
 
@@ -86,11 +293,32 @@ public:
 
     BigInteger operator*(const BigInteger &a) const;
 
-    BigInteger operator%=(const BigInteger &a);
+    BigInteger square() const;
+
+    BigInteger mulNTT(const BigInteger &a) const; // always multiply through the number-theoretic transform
+
+    BigInteger operator/(const BigInteger &a) const;
+
+    BigInteger operator%(const BigInteger &a) const;
+
+    // compound forms work in place and keep the limb storage of *this
+    BigInteger &operator+=(const BigInteger &a);
+
+    BigInteger &operator-=(const BigInteger &a);
+
+    BigInteger &operator*=(const BigInteger &a);
+
+    BigInteger &operator/=(const BigInteger &a);
+
+    BigInteger &operator%=(const BigInteger &a);
+
+    BigInteger operator>>(int i) const; // shifts |x|, keeping the sign
+
+    BigInteger operator<<(int i) const;
 
-    BigInteger operator>>(int i);
+    BigInteger &operator>>=(int i);
 
-    BigInteger operator<<(int i);
+    BigInteger &operator<<=(int i);
 
     string toString() const; // convert to binary string
 
@@ -106,28 +334,255 @@ public:
 
     BigInteger powMod(const BigInteger &a, const BigInteger &mod) const;
 
+    BigInteger powModConstTime(const BigInteger &a, const BigInteger &mod) const; // odd mod, a >= 0; for secret exponents
+
     BigInteger pow(int n);
 
     int bitLength() const; 
 
     string toDecimal() const; // convert to decimal string
+
+    static BigInteger fromDecimal(string_view s); // parse an optionally signed decimal string
+
+    static BigInteger fromHex(string_view s); // optional sign and 0x prefix, either case
+
+    string toHex() const; // lowercase, '-' for negative values
+
+    void toHex(span<char> out) const; // |x| as exactly out.size() hex digits, zero padded
+
+    static BigInteger fromBytes(span<const uint8_t> bytes, ByteOrder order = ByteOrder::BigEndian); // unsigned
+
+    size_t byteLength() const; // bytes needed for |x|, 0 for zero
+
+    vector<uint8_t> toBytes(ByteOrder order = ByteOrder::BigEndian) const; // |x| in byteLength() bytes
+
+    void toBytes(span<uint8_t> out, ByteOrder order = ByteOrder::BigEndian) const; // |x| zero padded to out.size()
+};
+
+// Reciprocal of a fixed divisor, computed once by Newton iteration. Each division then
+// costs a few multiplications (Barrett), which pays off for large or repeated divisors.
+class Reciprocal {
+private:
+    BigInteger d;     // the divisor
+    BigInteger norm;  // |d| shifted left until its top limb is full
+    BigInteger inv;   // floor(BASE^(2m) / norm), m = norm.size()
+    int shift;
+
+public:
+    explicit Reciprocal(const BigInteger &divisor);
+
+    const BigInteger &divisor() const;
+
+    // same semantics as divide(): truncated quotient, remainder with the sign of a
+    void divmod(const BigInteger &a, BigInteger &quotient, BigInteger &remainder) const;
+
+    BigInteger quotient(const BigInteger &a) const;
+
+    BigInteger remainder(const BigInteger &a) const;
+};
+
+// Montgomery arithmetic modulo a fixed odd modulus n with R = BASE^k, k = n.size().
+// Values in Montgomery form are k-limb arrays holding x * R mod n.
+class MontgomeryContext {
+private:
+    BigInteger n;
+    LimbVector mod;  // n as k limbs
+    LimbVector r2;   // R^2 mod n
+    LimbVector one;  // R mod n, i.e. 1 in Montgomery form
+    TYPE ninv;         // -n^-1 mod BASE
+    int k;
+
+    void redc(TYPE *r, TYPE *t) const; // r = t * R^-1 mod n for t < n * R, clobbers t[0..2k]
+
+    void to_montgomery(TYPE *r, const BigInteger &x) const; // r = x * R mod n, k limbs
+
+    BigInteger from_montgomery(const TYPE *x) const;
+
+    // the constant-time path: CIOS for every k and a masked final subtraction, so neither the
+    // control flow nor the memory accesses depend on the operands
+    void mul_ct(TYPE *r, const TYPE *a, const TYPE *b) const; // r = a * b * R^-1 mod n for a < R, b < n
+
+    void to_montgomery_ct(TYPE *r, const BigInteger &x) const; // r = x * R mod n without a division
+
+    friend class RsaPrivateKey; // CRT recombination on the constant-time primitives
+
+public:
+    explicit MontgomeryContext(const BigInteger &modulus);
+
+    const BigInteger &modulus() const;
+
+    int limbs() const;
+
+    vector<TYPE> toMontgomery(const BigInteger &x) const;
+
+    BigInteger fromMontgomery(const vector<TYPE> &x) const;
+
+    void mul(TYPE *r, const TYPE *a, const TYPE *b) const; // r = a * b * R^-1 mod n, r may alias a or b
+
+    void sqr(TYPE *r, const TYPE *a) const; // r = a^2 * R^-1 mod n, r may alias a
+
+    void add(TYPE *r, const TYPE *a, const TYPE *b) const; // r = a + b mod n, r may alias a or b; branch-free
+
+    void sub(TYPE *r, const TYPE *a, const TYPE *b) const; // r = a - b mod n, r may alias a or b; branch-free
+
+    void half(TYPE *r, const TYPE *a) const; // r = a / 2 mod n, r may alias a
+
+    vector<TYPE> pow(const vector<TYPE> &x, const BigInteger &e) const; // x^e, both in Montgomery form, e >= 0
+
+    // x^e in Montgomery form by fixed windows and branch-free products, for secret e; a secret
+    // base should go through powModConstTime, since toMontgomery reduces with a plain %
+    vector<TYPE> powConstTime(const vector<TYPE> &x, const BigInteger &e) const;
+
+    BigInteger powModConstTime(const BigInteger &base, const BigInteger &e) const; // for secret base and e >= 0
+
+    BigInteger mulMod(const BigInteger &a, const BigInteger &b) const;
+
+    BigInteger powMod(const BigInteger &base, const BigInteger &e) const;
 };
 
-int msbPosition(ll x); // get the most significant bit position
+// Powers of one fixed base modulo a fixed odd modulus, using a Lim-Lee comb. The exponent
+// range [0, 2^maxExponentBits) is split into h blocks of v sub-blocks each and the table holds
+// v * 2^h Montgomery-form products of base^(2^i), so one evaluation needs only about
+// maxExponentBits / (h * v) squarings. h and v are picked to fit memoryBudget bytes; the
+// smallest comb (h = v = 1) still holds two entries, so a budget below two Montgomery values
+// of the modulus size gets that two-entry table rather than an error.
+class FixedBasePowContext {
+private:
+    MontgomeryContext ctx;
+    vector<TYPE> base;            // Montgomery form
+    int max_bits;
+    int h, v;                     // teeth and sub-blocks of the comb
+    int a, b;                     // block and sub-block widths in bits
+    vector<vector<vector<TYPE>>> table; // table[s][i] = prod over set bits j of i of base^(2^(j*a + s*b))
+
+public:
+    FixedBasePowContext(const BigInteger &base, const BigInteger &modulus, int maxExponentBits,
+                        size_t memoryBudget = 1 << 20);
+
+    BigInteger powMod(const BigInteger &e) const; // base^e mod modulus, e < 0 gives the inverse power
+
+    size_t tableBytes() const;
+};
+
+// RSA private key in CRT form. Private-key operations exponentiate modulo p and q with
+// the half-size exponents dp and dq, optionally on two threads, and recombine the halves
+// with Garner's formula m = m2 + q * (qInv * (m1 - m2) mod p).
+class RsaPrivateKey {
+private:
+    BigInteger n, e, d;
+    BigInteger p, q;
+    BigInteger dp, dq; // d mod (p - 1), d mod (q - 1)
+    BigInteger qInv;   // q^-1 mod p
+    MontgomeryContext ctx_p, ctx_q;
+
+public:
+    RsaPrivateKey(const BigInteger &p, const BigInteger &q, const BigInteger &e);
+
+    // prime searches run on `threads` threads, 0 for one per core; e must be odd and above 1
+    static RsaPrivateKey generate(int bits, const BigInteger &e = BigInteger(65537ll), int threads = 1);
+
+    const BigInteger &modulus() const;
+
+    const BigInteger &publicExponent() const;
+
+    const BigInteger &privateExponent() const;
+
+    BigInteger encrypt(const BigInteger &m) const; // m^e mod n
+
+    BigInteger decrypt(const BigInteger &c, bool parallel = false) const; // c^d mod n
+
+    BigInteger sign(const BigInteger &m, bool parallel = false) const; // m^d mod n
+};
+
+// Barrett reduction modulo a fixed modulus m of k bits, odd or even. mu = floor(4^k / m) is
+// computed once, after which reducing anything below 4^k takes two multiplications.
+class BarrettContext {
+private:
+    BigInteger m;
+    BigInteger mu;
+    int k;
+
+public:
+    explicit BarrettContext(const BigInteger &modulus);
 
-auto bezout(const BigInteger &x, const BigInteger &y);
+    const BigInteger &modulus() const;
+
+    BigInteger reduce(const BigInteger &x) const; // x mod m in [0, m), for any x
+
+    BigInteger powMod(const BigInteger &base, const BigInteger &e) const; // e >= 0
+};
+
+int msbPosition(ull x); // get the most significant bit position
+
+// window width minimizing squarings plus table multiplications for a sliding-window power
+// with an exponent of that many bits, from 1 up to 7
+int window_size(int bits);
+
+auto bezout(const BigInteger &x, const BigInteger &y); // a x + b y = d = gcd(|x|, |y|)
+
+BigInteger gcd(const BigInteger &x, const BigInteger &y); // gcd(|x|, |y|), no cofactors
 
 auto divide(const BigInteger &a, const BigInteger &b); // divide two big integers
 
 BigInteger lcm(const BigInteger &x, const BigInteger &y);
 
-bool Miller_Rabin_check(const BigInteger &n);
+// Which check decided a primality test.
+enum class PrimalityReason {
+    TooSmall,      // n < 2
+    SmallPrime,    // n is one of the trial division primes
+    SmallFactor,   // n has a small factor, the witness
+    TrialDivision, // n is below the square of the largest trial division prime and has no factor
+    MillerRabin,   // n is not a strong probable prime to base witness
+    PerfectSquare, // n is a perfect square, found while choosing the Lucas parameters
+    Lucas,         // n is not a strong Lucas probable prime with Selfridge's parameters
+    Passed         // n passed every test; proved prime below 2^78
+};
+
+struct PrimalityResult {
+    bool probablePrime;
+    PrimalityReason reason;
+    BigInteger witness; // base or factor proving n composite, 0 otherwise
+};
+
+struct PrimalityOptions {
+    int rounds = 0;            // random-base Miller-Rabin rounds on top of Baillie-PSW
+    mt19937_64 *rng = nullptr; // source of the random bases, nullptr for one seeded with `seed`
+    ull seed = 0;
+};
+
+// Trial division, then the deterministic Miller-Rabin base set {2, ..., 37} below 2^78 and
+// Baillie-PSW (base-2 Miller-Rabin plus a strong Lucas test) above it.
+PrimalityResult primality_test(const BigInteger &n, const PrimalityOptions &options = {});
+
+bool is_probable_prime(const BigInteger &n, int rounds = 0, mt19937_64 *rng = nullptr);
+
+bool Miller_Rabin_check(const BigInteger &n); // primality_test(n).probablePrime
+
+// is_probable_prime for every candidate. Candidates are trial-divided in groups by
+// reducing the product of all primes below 2^15 down a remainder tree, and only the
+// survivors get Baillie-PSW; groups are spread over `threads` workers, 0 for one per core.
+vector<bool> batch_is_probable_prime(span<const BigInteger> candidates, int threads = 0);
 
 string hex_to_bin(const string &hex);
 
-BigInteger generate_large_prime(int bit_length);
+BigInteger generate_large_prime(int bit_length, int threads = 1); // threads = 0 uses one per core
+
+// `count` distinct probable primes of bit_length bits, searched on `threads` workers with
+// independent random streams; the search stops as soon as enough primes are found
+vector<BigInteger> generate_large_primes(int bit_length, int count, int threads = 0);
+
+BigInteger mod_inverse(const BigInteger &a, const BigInteger &n); // variable time, in [0, |n|)
+
+// Same result with a fixed sequence of divsteps for the modulus size (Bernstein-Yang
+// safegcd), for secret a; n must be odd and 0 <= a < n, which is checked and not reduced
+BigInteger mod_inverse_consttime(const BigInteger &a, const BigInteger &n);
+
+// every a[i]^-1 mod n from a single inversion; throws if any a[i] is not invertible
+vector<BigInteger> mod_inverse_batch(const vector<BigInteger> &a, const BigInteger &n);
+
+BigInteger addMod(const BigInteger &a, const BigInteger &b, const BarrettContext &ctx);
 
-BigInteger mod_inverse(const BigInteger &a, const BigInteger &n);
+BigInteger mulMod(const BigInteger &a, const BigInteger &b, const BarrettContext &ctx);
 
 string string_to_binary(const string &s);
 
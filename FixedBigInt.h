@@ -0,0 +1,438 @@
+/*
+    Description: This file contains fixed-width unsigned integers for known key sizes.
+    FixedBigInt<Bits> keeps its limbs in a std::array, so it never allocates, never trims and
+    every loop has a trip count known at compile time. FixedMontgomery<Bits> is the modular
+    layer on top of it, the counterpart of MontgomeryContext for one exact operand width.
+    Both convert to and from BigInteger.
+*/
+
+#ifndef FIXEDBIGINT_H
+#define FIXEDBIGINT_H
+
+#include "BigInteger.h"
+#include <array>
+#include <compare>
+
+// Unsigned integer of exactly Bits bits, Bits a multiple of 64, with wrap-around arithmetic
+// modulo 2^Bits like the built-in unsigned types. All arithmetic is constexpr.
+template <int Bits>
+class FixedBigInt {
+    static_assert(Bits > 0 && Bits % BIT_PER_DIGIT == 0, "FixedBigInt needs a positive multiple of 64 bits");
+
+public:
+    static constexpr int LIMBS = Bits / BIT_PER_DIGIT;
+
+    array<ull, LIMBS> limbs{}; // little-endian
+
+    constexpr FixedBigInt() = default;
+
+    constexpr explicit FixedBigInt(ull x) { limbs[0] = x; }
+
+    static FixedBigInt fromBigInteger(const BigInteger &x); // 0 <= x < 2^Bits
+
+    BigInteger toBigInteger() const;
+
+    constexpr bool is_zero() const;
+
+    constexpr int bit(int i) const;
+
+    constexpr int bitLength() const;
+
+    static constexpr ull add(FixedBigInt &r, const FixedBigInt &a, const FixedBigInt &b); // returns the carry
+
+    static constexpr ull sub(FixedBigInt &r, const FixedBigInt &a, const FixedBigInt &b); // returns the borrow
+
+    constexpr FixedBigInt &operator+=(const FixedBigInt &a) { add(*this, *this, a); return *this; }
+
+    constexpr FixedBigInt &operator-=(const FixedBigInt &a) { sub(*this, *this, a); return *this; }
+
+    constexpr FixedBigInt &operator*=(const FixedBigInt &a) { return *this = *this * a; }
+
+    constexpr FixedBigInt &operator<<=(int i) { return *this = *this << i; }
+
+    constexpr FixedBigInt &operator>>=(int i) { return *this = *this >> i; }
+
+    constexpr FixedBigInt operator+(const FixedBigInt &a) const { FixedBigInt r; add(r, *this, a); return r; }
+
+    constexpr FixedBigInt operator-(const FixedBigInt &a) const { FixedBigInt r; sub(r, *this, a); return r; }
+
+    constexpr FixedBigInt operator*(const FixedBigInt &a) const; // low Bits bits of the product
+
+    constexpr FixedBigInt operator<<(int i) const; // 0 <= i
+
+    constexpr FixedBigInt operator>>(int i) const; // 0 <= i
+
+    constexpr bool operator==(const FixedBigInt &a) const { return limbs == a.limbs; }
+
+    constexpr strong_ordering operator<=>(const FixedBigInt &a) const;
+};
+
+// the full 2 * Bits-bit product
+template <int Bits>
+constexpr FixedBigInt<2 * Bits> mul_wide(const FixedBigInt<Bits> &a, const FixedBigInt<Bits> &b);
+
+// Montgomery arithmetic modulo a fixed odd n < 2^Bits with R = 2^Bits. Values in Montgomery
+// form are FixedBigInts below n; mul() is a CIOS pass whose inner loops the compiler unrolls
+// for the given width, with the running row kept in a local array.
+template <int Bits>
+class FixedMontgomery {
+public:
+    using Int = FixedBigInt<Bits>;
+
+    explicit FixedMontgomery(const Int &modulus);
+
+    explicit FixedMontgomery(const BigInteger &modulus) : FixedMontgomery(Int::fromBigInteger(modulus)) {}
+
+    const Int &modulus() const { return n; }
+
+    const Int &one() const { return r1; } // R mod n, i.e. 1 in Montgomery form
+
+    Int toMontgomery(const Int &x) const { return mul(x, r2); } // any x < 2^Bits
+
+    Int fromMontgomery(const Int &x) const { return mul(x, Int(1)); }
+
+    constexpr Int mul(const Int &a, const Int &b) const; // a * b * R^-1 mod n
+
+    constexpr Int sqr(const Int &a) const; // a^2 * R^-1 mod n
+
+    constexpr Int add(const Int &a, const Int &b) const; // a + b mod n
+
+    constexpr Int sub(const Int &a, const Int &b) const; // a - b mod n
+
+    Int pow(const Int &x, const Int &e) const; // x^e with x and the result in Montgomery form
+
+    Int powMod(const Int &base, const Int &e) const; // base^e mod n on plain values
+
+    BigInteger powMod(const BigInteger &base, const BigInteger &e) const; // 0 <= base, 0 <= e < 2^Bits
+
+private:
+    Int n;
+    Int r1;   // R mod n
+    Int r2;   // R^2 mod n
+    ull ninv; // -n^-1 mod 2^64
+
+    // t[0..2L] * R^-1 mod n for t < n * R, as L rows of single-limb reductions
+    constexpr Int redc(array<ull, 2 * Int::LIMBS + 1> &t) const;
+};
+
+template <int Bits>
+FixedBigInt<Bits> FixedBigInt<Bits>::fromBigInteger(const BigInteger &x) {
+    if (x.getSign() < 0 || x.bitLength() > Bits) {
+        throw "Value does not fit the fixed width";
+    }
+    FixedBigInt r;
+    const LimbVector &d = x.getLimbs();
+    copy(d.begin(), d.begin() + min((int)d.size(), LIMBS), r.limbs.begin());
+    return r;
+}
+
+template <int Bits>
+BigInteger FixedBigInt<Bits>::toBigInteger() const {
+    BigInteger res;
+    res.setLimbs(LimbVector(limbs.data(), limbs.data() + LIMBS));
+    res.trim();
+    return res;
+}
+
+template <int Bits>
+constexpr bool FixedBigInt<Bits>::is_zero() const {
+    ull any = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        any |= limbs[i];
+    }
+    return any == 0;
+}
+
+template <int Bits>
+constexpr int FixedBigInt<Bits>::bit(int i) const {
+    return limbs[i / BIT_PER_DIGIT] >> (i % BIT_PER_DIGIT) & 1;
+}
+
+template <int Bits>
+constexpr int FixedBigInt<Bits>::bitLength() const {
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        if (limbs[i]) {
+            return i * BIT_PER_DIGIT + 64 - __builtin_clzll(limbs[i]);
+        }
+    }
+    return 0;
+}
+
+template <int Bits>
+constexpr ull FixedBigInt<Bits>::add(FixedBigInt &r, const FixedBigInt &a, const FixedBigInt &b) {
+    ull carry = 0;
+#pragma GCC unroll 128
+    for (int i = 0; i < LIMBS; i++) {
+        u128 t = (u128)a.limbs[i] + b.limbs[i] + carry;
+        r.limbs[i] = (ull)t;
+        carry = (ull)(t >> BIT_PER_DIGIT);
+    }
+    return carry;
+}
+
+template <int Bits>
+constexpr ull FixedBigInt<Bits>::sub(FixedBigInt &r, const FixedBigInt &a, const FixedBigInt &b) {
+    ull borrow = 0;
+#pragma GCC unroll 128
+    for (int i = 0; i < LIMBS; i++) {
+        u128 t = (u128)a.limbs[i] - b.limbs[i] - borrow;
+        r.limbs[i] = (ull)t;
+        borrow = (ull)(t >> BIT_PER_DIGIT) & 1;
+    }
+    return borrow;
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::operator*(const FixedBigInt &a) const {
+    FixedBigInt r;
+    for (int i = 0; i < LIMBS; i++) {
+        ull carry = 0;
+#pragma GCC unroll 128
+        for (int j = 0; i + j < LIMBS; j++) {
+            u128 t = (u128)limbs[i] * a.limbs[j] + r.limbs[i + j] + carry;
+            r.limbs[i + j] = (ull)t;
+            carry = (ull)(t >> BIT_PER_DIGIT);
+        }
+    }
+    return r;
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::operator<<(int i) const {
+    FixedBigInt r;
+    int q = i / BIT_PER_DIGIT, s = i % BIT_PER_DIGIT;
+    for (int j = LIMBS - 1; j >= q; j--) {
+        ull low = j - q - 1 >= 0 && s ? limbs[j - q - 1] >> (BIT_PER_DIGIT - s) : 0;
+        r.limbs[j] = limbs[j - q] << s | low;
+    }
+    return r;
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::operator>>(int i) const {
+    FixedBigInt r;
+    int q = i / BIT_PER_DIGIT, s = i % BIT_PER_DIGIT;
+    for (int j = 0; j + q < LIMBS; j++) {
+        ull high = j + q + 1 < LIMBS && s ? limbs[j + q + 1] << (BIT_PER_DIGIT - s) : 0;
+        r.limbs[j] = limbs[j + q] >> s | high;
+    }
+    return r;
+}
+
+template <int Bits>
+constexpr strong_ordering FixedBigInt<Bits>::operator<=>(const FixedBigInt &a) const {
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        if (limbs[i] != a.limbs[i]) {
+            return limbs[i] <=> a.limbs[i];
+        }
+    }
+    return strong_ordering::equal;
+}
+
+template <int Bits>
+constexpr FixedBigInt<2 * Bits> mul_wide(const FixedBigInt<Bits> &a, const FixedBigInt<Bits> &b) {
+    constexpr int L = FixedBigInt<Bits>::LIMBS;
+    FixedBigInt<2 * Bits> r;
+    for (int i = 0; i < L; i++) {
+        ull carry = 0;
+#pragma GCC unroll 128
+        for (int j = 0; j < L; j++) {
+            u128 t = (u128)a.limbs[i] * b.limbs[j] + r.limbs[i + j] + carry;
+            r.limbs[i + j] = (ull)t;
+            carry = (ull)(t >> BIT_PER_DIGIT);
+        }
+        r.limbs[i + L] = carry;
+    }
+    return r;
+}
+
+template <int Bits>
+FixedMontgomery<Bits>::FixedMontgomery(const Int &modulus) : n(modulus) {
+    if (!(n.limbs[0] & 1) || n <= Int(1)) {
+        throw "Montgomery modulus must be odd and greater than 1";
+    }
+    // Newton iteration for n^-1 mod 2^64, each step doubles the number of correct low bits
+    ull n0 = n.limbs[0], inv = n0;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - n0 * inv;
+    }
+    ninv = 0 - inv;
+
+    BigInteger big_n = n.toBigInteger();
+    BigInteger R = BigInteger(1ll) << Bits;
+    r1 = Int::fromBigInteger(R % big_n);
+    r2 = Int::fromBigInteger((R * R) % big_n);
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedMontgomery<Bits>::mul(const Int &a, const Int &b) const {
+    constexpr int L = Int::LIMBS;
+    // CIOS with the product row and the reduction step fused into one pass over t, each
+    // with its own carry; t stays L + 1 limbs
+    array<ull, L + 1> t{};
+    for (int i = 0; i < L; i++) {
+        ull bi = b.limbs[i];
+        u128 p = (u128)a.limbs[0] * bi + t[0];
+        ull c1 = (ull)(p >> BIT_PER_DIGIT);
+        ull q = (ull)p * ninv;
+        u128 s = (u128)q * n.limbs[0] + (ull)p;
+        ull c2 = (ull)(s >> BIT_PER_DIGIT);
+#pragma GCC unroll 128
+        for (int j = 1; j < L; j++) {
+            p = (u128)a.limbs[j] * bi + t[j] + c1;
+            c1 = (ull)(p >> BIT_PER_DIGIT);
+            s = (u128)q * n.limbs[j] + (ull)p + c2;
+            c2 = (ull)(s >> BIT_PER_DIGIT);
+            t[j - 1] = (ull)s;
+        }
+        u128 top = (u128)t[L] + c1 + c2;
+        t[L - 1] = (ull)top;
+        t[L] = (ull)(top >> BIT_PER_DIGIT);
+    }
+    Int r;
+    copy(t.begin(), t.begin() + L, r.limbs.begin());
+    if (t[L] || r >= n) {
+        Int::sub(r, r, n);
+    }
+    return r;
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedMontgomery<Bits>::redc(array<ull, 2 * Int::LIMBS + 1> &t) const {
+    constexpr int L = Int::LIMBS;
+    for (int i = 0; i < L; i++) {
+        ull q = t[i] * ninv;
+        ull carry = 0;
+#pragma GCC unroll 128
+        for (int j = 0; j < L; j++) {
+            u128 cur = (u128)q * n.limbs[j] + t[i + j] + carry;
+            t[i + j] = (ull)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        for (int p = i + L; carry; p++) {
+            u128 cur = (u128)t[p] + carry;
+            t[p] = (ull)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+    }
+    // t / R = t[L..2L] < 2n
+    Int r;
+    copy(t.begin() + L, t.begin() + 2 * L, r.limbs.begin());
+    if (t[2 * L] || r >= n) {
+        Int::sub(r, r, n);
+    }
+    return r;
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedMontgomery<Bits>::sqr(const Int &a) const {
+    constexpr int L = Int::LIMBS;
+    // the products a[i] a[j] for i < j once, doubled, plus the squares on the diagonal
+    array<ull, 2 * L + 1> t{};
+    for (int i = 0; i < L; i++) {
+        ull carry = 0;
+#pragma GCC unroll 128
+        for (int j = i + 1; j < L; j++) {
+            u128 cur = (u128)a.limbs[i] * a.limbs[j] + t[i + j] + carry;
+            t[i + j] = (ull)cur;
+            carry = (ull)(cur >> BIT_PER_DIGIT);
+        }
+        t[i + L] = carry;
+    }
+    ull high = 0;
+    for (int i = 0; i < 2 * L; i++) {
+        ull v = t[i];
+        t[i] = v << 1 | high;
+        high = v >> (BIT_PER_DIGIT - 1);
+    }
+    ull carry = 0;
+    for (int i = 0; i < L; i++) {
+        u128 sq = (u128)a.limbs[i] * a.limbs[i];
+        u128 lo = (u128)t[2 * i] + (ull)sq + carry;
+        t[2 * i] = (ull)lo;
+        u128 hi = (u128)t[2 * i + 1] + (ull)(sq >> BIT_PER_DIGIT) + (ull)(lo >> BIT_PER_DIGIT);
+        t[2 * i + 1] = (ull)hi;
+        carry = (ull)(hi >> BIT_PER_DIGIT);
+    }
+    return redc(t);
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedMontgomery<Bits>::add(const Int &a, const Int &b) const {
+    Int r;
+    ull carry = Int::add(r, a, b);
+    if (carry || r >= n) {
+        Int::sub(r, r, n);
+    }
+    return r;
+}
+
+template <int Bits>
+constexpr FixedBigInt<Bits> FixedMontgomery<Bits>::sub(const Int &a, const Int &b) const {
+    Int r;
+    if (Int::sub(r, a, b)) {
+        Int::add(r, r, n);
+    }
+    return r;
+}
+
+template <int Bits>
+FixedBigInt<Bits> FixedMontgomery<Bits>::pow(const Int &x, const Int &e) const {
+    int bits = e.bitLength();
+    if (bits == 0) return r1;
+
+    // sliding windows over odd powers, table[i] = x^(2i+1); the width comes from the shared
+    // window_size() and is capped by MAX_WINDOW, which also sizes the table
+    constexpr int MAX_WINDOW = 6;
+    int w = min(window_size(bits), MAX_WINDOW);
+    array<Int, 1 << (MAX_WINDOW - 1)> table;
+    table[0] = x;
+    if (w > 1) {
+        Int x2 = sqr(x);
+        for (int i = 1; i < (1 << (w - 1)); i++) {
+            table[i] = mul(table[i - 1], x2);
+        }
+    }
+
+    Int res = r1;
+    bool started = false;
+    int i = bits - 1;
+    while (i >= 0) {
+        if (!e.bit(i)) {
+            if (started) res = sqr(res);
+            i--;
+            continue;
+        }
+        // longest window [i..j] of at most w bits ending in a set bit
+        int j = max(i - w + 1, 0);
+        while (!e.bit(j)) j++;
+        int window = 0;
+        for (int k = i; k >= j; k--) {
+            window = window << 1 | e.bit(k);
+        }
+        if (started) {
+            for (int k = i; k >= j; k--) {
+                res = sqr(res);
+            }
+            res = mul(res, table[window >> 1]);
+        } else {
+            res = table[window >> 1];
+            started = true;
+        }
+        i = j - 1;
+    }
+    return res;
+}
+
+template <int Bits>
+FixedBigInt<Bits> FixedMontgomery<Bits>::powMod(const Int &base, const Int &e) const {
+    return fromMontgomery(pow(toMontgomery(base), e));
+}
+
+template <int Bits>
+BigInteger FixedMontgomery<Bits>::powMod(const BigInteger &base, const BigInteger &e) const {
+    BigInteger b = base % n.toBigInteger();
+    return powMod(Int::fromBigInteger(b), Int::fromBigInteger(e)).toBigInteger();
+}
+
+#endif //FIXEDBIGINT_H
@@ -0,0 +1,1337 @@
+/*
+    Description: Regression tests for BigInteger. Results are checked against small reference
+implementations on 32-bit words written here, or through the defining identities of each
+operation. Prints each failure and exits non-zero if any check fails.
+
+    Build: g++ -O2 -std=c++20 test_biginteger.cpp -o test_biginteger
+*/
+
+#include "BigInteger.cpp"
+#include "FixedBigInt.h"
+#include <map>
+
+mt19937_64 rng(20240917);
+int failures = 0;
+
+#define CHECK(cond, what) \
+    do { \
+        if (!(cond)) { \
+            failures++; \
+            cout << "FAIL " << what << " (line " << __LINE__ << ")" << endl; \
+        } \
+    } while (0)
+
+// magnitude as little-endian 32-bit words, independent of the limb width
+using Words = vector<uint32_t>;
+
+// random binary string of exactly bits bits, often with long runs of ones or zeros to stress the carries
+string random_binary(int bits) {
+    string s(bits, '0');
+    int mode = rng() % 3;
+    for (int i = 0; i < bits; i++) {
+        if (mode == 0) {
+            s[i] = '0' + rng() % 2;
+        } else if (i == 0 || rng() % 16 == 0) {
+            s[i] = '0' + rng() % 2;
+        } else {
+            s[i] = s[i - 1];
+        }
+    }
+    s[0] = '1';
+    return s;
+}
+
+BigInteger random_number(int bits, bool allowNegative = false) {
+    string s = random_binary(bits);
+    return BigInteger(allowNegative && rng() % 2 ? "-" + s : s);
+}
+
+// random odd number greater than 1
+BigInteger random_odd(int bits) {
+    string s = random_binary(max(bits, 2));
+    s.back() = '1';
+    return BigInteger(s);
+}
+
+Words to_words(const BigInteger &x) {
+    string s = x.toString();
+    if (s[0] == '-') s = s.substr(1);
+    Words w((s.size() + 31) / 32, 0);
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[s.size() - 1 - i] == '1') w[i / 32] |= 1u << (i % 32);
+    }
+    return w;
+}
+
+BigInteger from_words(const Words &w, bool negative = false) {
+    string s;
+    for (int i = (int)w.size() * 32 - 1; i >= 0; i--) {
+        s += w[i / 32] >> (i % 32) & 1 ? '1' : '0';
+    }
+    size_t first = s.find('1');
+    if (first == string::npos) return BigInteger(0ll);
+    s = s.substr(first);
+    return BigInteger(negative ? "-" + s : s);
+}
+
+BigInteger decimal(const string &s) {
+    return s[0] == '-' ? BigInteger(s.substr(1), 10, -1) : BigInteger(s, 10, 1);
+}
+
+// decimal digits of x by repeated short division of its words by 10^9
+string ref_decimal(const BigInteger &x) {
+    Words w = to_words(x);
+    string digits;
+    while (!w.empty()) {
+        uint64_t rem = 0;
+        for (int i = (int)w.size() - 1; i >= 0; i--) {
+            uint64_t cur = rem << 32 | w[i];
+            w[i] = (uint32_t)(cur / 1000000000);
+            rem = cur % 1000000000;
+        }
+        while (!w.empty() && !w.back()) w.pop_back();
+        for (int i = 0; i < 9; i++, rem /= 10) {
+            digits += char('0' + rem % 10);
+        }
+    }
+    while (digits.size() > 1 && digits.back() == '0') digits.pop_back();
+    if (digits.empty()) digits = "0";
+    if (x.getSign() < 0 && !x.is_zero()) digits += '-';
+    reverse(digits.begin(), digits.end());
+    return digits;
+}
+
+// schoolbook product of magnitudes
+Words ref_multiply(const Words &a, const Words &b) {
+    Words r(a.size() + b.size(), 0);
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); j++) {
+            uint64_t t = (uint64_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        r[i + b.size()] = (uint32_t)carry;
+    }
+    return r;
+}
+
+BigInteger ref_product(const BigInteger &a, const BigInteger &b) {
+    bool negative = a.getSign() != b.getSign() && !a.is_zero() && !b.is_zero();
+    return from_words(ref_multiply(to_words(a), to_words(b)), negative);
+}
+
+// in [0, m)
+BigInteger non_negative_mod(const BigInteger &x, const BigInteger &m) {
+    BigInteger r = x % m;
+    return r.getSign() < 0 ? r + m : r;
+}
+
+// a default-constructed BigInteger is a zero without limbs and is not == BigInteger(0ll),
+// and mulMod returns one for a zero operand, so modular results are compared by value
+bool same_value(const BigInteger &x, const BigInteger &y) {
+    return x.toString() == y.toString();
+}
+
+template <class F>
+bool throws(F f) {
+    try {
+        f();
+    } catch (const char *) {
+        return true;
+    }
+    return false;
+}
+
+// left-to-right square-and-multiply with plain division
+BigInteger ref_pow_mod(const BigInteger &base, const BigInteger &e, const BigInteger &m) {
+    BigInteger result(1ll), b = non_negative_mod(base, m);
+    for (char bit : e.toString()) {
+        result = result * result % m;
+        if (bit == '1') result = result * b % m;
+    }
+    return result % m;
+}
+
+// a + b on magnitudes
+Words ref_add(const Words &a, const Words &b) {
+    Words r(max(a.size(), b.size()) + 1, 0);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < r.size(); i++) {
+        carry += (uint64_t)(i < a.size() ? a[i] : 0) + (i < b.size() ? b[i] : 0);
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    return r;
+}
+
+bool ref_less(Words a, Words b) {
+    while (!a.empty() && a.back() == 0) a.pop_back();
+    while (!b.empty() && b.back() == 0) b.pop_back();
+    if (a.size() != b.size()) return a.size() < b.size();
+    return lexicographical_compare(a.rbegin(), a.rend(), b.rbegin(), b.rend());
+}
+
+// a - b on magnitudes, a >= b
+Words ref_sub(const Words &a, const Words &b) {
+    Words r(a.size(), 0);
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int64_t cur = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = cur < 0;
+        r[i] = (uint32_t)(cur + (borrow << 32));
+    }
+    return r;
+}
+
+// signed a + b through the magnitude references
+BigInteger ref_sum(const BigInteger &a, const BigInteger &b) {
+    Words x = to_words(a), y = to_words(b);
+    bool na = a.getSign() < 0, nb = b.getSign() < 0;
+    if (na == nb) return from_words(ref_add(x, y), na);
+    if (ref_less(x, y)) return from_words(ref_sub(y, x), nb);
+    return from_words(ref_sub(x, y), na);
+}
+
+void test_small_buffer() {
+    const size_t inline_limbs = LimbVector::INLINE_LIMBS;
+    for (size_t limbs : {(size_t)1, inline_limbs - 1, inline_limbs, inline_limbs + 1, 4 * inline_limbs}) {
+        BigInteger x = random_number(64 * limbs, true);
+        CHECK(x.getLimbs().size() == limbs && x.getLimbs().is_inline() == (limbs <= inline_limbs), "storage of " << limbs << " limbs");
+        string bits = x.toString();
+
+        BigInteger copy(x);
+        CHECK(copy == x && copy.getLimbs().data() != x.getLimbs().data(), "copy of " << limbs << " limbs");
+        BigInteger moved(move(copy));
+        CHECK(moved.toString() == bits, "move of " << limbs << " limbs");
+        copy = x;
+        CHECK(copy.toString() == bits, "assign into a moved-from value");
+
+        // assignment both ways between inline and heap sizes
+        BigInteger small(7ll), large = random_number(64 * 3 * inline_limbs);
+        small = x;
+        large = x;
+        CHECK(small.toString() == bits && large.toString() == bits, "copy-assign " << limbs << " limbs");
+        small = BigInteger(7ll);
+        large = move(small);
+        CHECK(large == BigInteger(7ll), "move-assign a small value over " << limbs << " limbs");
+        BigInteger &self = x;
+        x = self;
+        CHECK(x.toString() == bits, "self-assignment of " << limbs << " limbs");
+    }
+
+    // values of every size shuffled through a growing vector and a map
+    vector<BigInteger> values;
+    map<string, BigInteger> byBits;
+    for (int i = 0; i < 200; i++) {
+        values.push_back(random_number(1 + rng() % (64 * 3 * inline_limbs), true));
+        byBits[values.back().toString()] = values.back();
+    }
+    vector<BigInteger> sorted = values;
+    sort(sorted.begin(), sorted.end(), [](const BigInteger &a, const BigInteger &b) { return a < b; });
+    bool ok = true;
+    for (const BigInteger &v : values) {
+        ok = ok && byBits.at(v.toString()) == v;
+    }
+    for (size_t i = 1; i < sorted.size(); i++) {
+        ok = ok && !(sorted[i] < sorted[i - 1]);
+    }
+    CHECK(ok, "BigInteger in standard containers");
+
+    LimbVector v;
+    for (TYPE i = 0; i < 3 * inline_limbs; i++) v.push_back(i);
+    v.resize(inline_limbs + 2, 9);
+    v.resize(inline_limbs + 4, 9);
+    CHECK(v.size() == inline_limbs + 4 && v[inline_limbs + 1] == inline_limbs + 1 && v[inline_limbs + 2] == 9 && v.back() == 9, "LimbVector resize");
+    LimbVector w(v.begin(), v.begin() + 3);
+    CHECK(w.size() == 3 && w.is_inline() && w[2] == 2, "LimbVector from a range");
+    w = v;
+    CHECK(w == v, "LimbVector copy");
+}
+
+// n random limbs, often runs of all-ones or zero limbs so carries travel across vector blocks
+vector<TYPE> random_limbs(int n) {
+    vector<TYPE> d(n);
+    int mode = rng() % 3;
+    for (TYPE &x : d) {
+        x = rng();
+        if (mode == 1 && rng() % 2) x = ~0ull;
+        if (mode == 2 && rng() % 2) x = 0;
+    }
+    return d;
+}
+
+// every kernel of k against the scalar loops, also in place and on overlapping ranges
+void check_limb_kernels(const LimbKernels &k, const char *name) {
+    for (int it = 0; it < 20000; it++) {
+        int n = 1 + rng() % 70, s = 1 + rng() % 63, off = rng() % 4;
+        vector<TYPE> a = random_limbs(n + 8), b = random_limbs(n + 8);
+        if (rng() % 3 == 0) {
+            b = a;
+            if (rng() % 2) b[rng() % n] ^= 1ull << (rng() % 64);
+        }
+        vector<TYPE> r1(n + 8), r2(n + 8);
+        bool ok = add_n_scalar(r1.data(), a.data(), b.data(), n) == k.add_n(r2.data(), a.data(), b.data(), n) && r1 == r2;
+        ok &= sub_n_scalar(r1.data(), a.data(), b.data(), n) == k.sub_n(r2.data(), a.data(), b.data(), n) && r1 == r2;
+        ok &= cmp_n_scalar(a.data(), b.data(), n) == k.cmp_n(a.data(), b.data(), n);
+        ok &= lshift_scalar(r1.data(), a.data(), n, s) == k.lshift(r2.data(), a.data(), n, s) && r1 == r2;
+        rshift_scalar(r1.data(), a.data(), n, s);
+        k.rshift(r2.data(), a.data(), n, s);
+        ok &= r1 == r2;
+        vector<TYPE> x = a, y = a;
+        ok &= add_n_scalar(x.data(), x.data(), b.data(), n) == k.add_n(y.data(), y.data(), b.data(), n) && x == y;
+        x = a, y = a;
+        ok &= sub_n_scalar(x.data(), x.data(), b.data(), n) == k.sub_n(y.data(), y.data(), b.data(), n) && x == y;
+        x = a, y = a;
+        ok &= lshift_scalar(x.data(), x.data(), n, s) == k.lshift(y.data(), y.data(), n, s) && x == y;
+        x = a, y = a;
+        rshift_scalar(x.data(), x.data() + off, n + 8 - off, s);
+        k.rshift(y.data(), y.data() + off, n + 8 - off, s);
+        ok &= x == y;
+        CHECK(ok, name << " kernels n=" << n << " s=" << s);
+        if (!ok) return;
+    }
+}
+
+void test_limb_kernels() {
+    check_limb_kernels(limb_kernels(), "dispatched");
+#ifdef BIGINT_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        check_limb_kernels({add_n_avx2, sub_n_avx2, cmp_n_avx2, lshift_avx2, rshift_avx2}, "AVX2");
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        check_limb_kernels({add_n_avx512, sub_n_avx512, cmp_n_avx512, lshift_avx512, rshift_avx512}, "AVX-512");
+    }
+#endif
+}
+
+void test_add_sub() {
+    for (int it = 0; it < 600; it++) {
+        BigInteger a = random_number(1 + rng() % 3000, true), b = random_number(1 + rng() % 3000, true);
+        if (it % 5 == 0) b = it % 10 == 0 ? a : BigInteger(0ll) - a;
+        BigInteger nb = BigInteger(0ll) - b;
+        CHECK(a + b == ref_sum(a, b), "add " << a.bitLength() << " + " << b.bitLength() << " bits");
+        CHECK(a - b == ref_sum(a, nb), "subtract " << a.bitLength() << " - " << b.bitLength() << " bits");
+    }
+    // all-ones values carry through every limb and borrow back down
+    for (int limbs = 1; limbs <= 40; limbs++) {
+        BigInteger ones(string(64 * limbs, '1')), one(1ll);
+        BigInteger power("1" + string(64 * limbs, '0'));
+        CHECK(ones + one == power && power - one == ones && one - power == BigInteger(0ll) - ones, "carry across " << limbs << " limbs");
+        CHECK(ones + ones == ref_sum(ones, ones), "ones doubled across " << limbs << " limbs");
+    }
+}
+
+void test_limbs() {
+    BigInteger x("1" + string(61, '0') + "101");
+    const auto &limbs = x.getLimbs();
+    CHECK(limbs.size() == 2 && limbs[0] == 5 && limbs[1] == 1, "limbs of 2^64 + 5");
+    BigInteger y;
+    y.setLimbs(vector<TYPE>{~0ull, ~0ull});
+    y.setSign(1);
+    CHECK(y == BigInteger(string(128, '1')), "setLimbs with full-width limbs");
+    CHECK((vector<TYPE>(x.getLimbs()) == vector<TYPE>{5, 1} && vector<TYPE>(y.getLimbs()) == vector<TYPE>{~0ull, ~0ull}), "limbs as a vector");
+    BigInteger big = random_number(64 * 3 * LimbVector::INLINE_LIMBS);
+    vector<TYPE> heap(big.getLimbs());
+    CHECK(heap.size() == big.getLimbs().size() && equal(heap.begin(), heap.end(), big.getLimbs().begin()), "heap limbs as a vector");
+    CHECK(BigInteger(-1ll) == BigInteger("-1") && BigInteger(LLONG_MIN) == BigInteger("-1" + string(63, '0')), "BigInteger(ll) at the extremes");
+}
+
+void test_compound() {
+    for (int it = 0; it < 300; it++) {
+        BigInteger a = random_number(1 + rng() % 2000, true), b = random_number(1 + rng() % 1200, true);
+        int s = rng() % 300;
+        BigInteger x = a;
+        CHECK((x += b) == ref_sum(a, b) && x == ref_sum(a, b), "+= " << it);
+        x = a;
+        CHECK((x -= b) == a - b, "-= " << it);
+        x = a;
+        CHECK((x *= b) == ref_product(a, b), "*= " << it);
+        x = a;
+        CHECK((x /= b) == a / b, "/= " << it);
+        x = a;
+        CHECK((x %= b) == a % b, "%= " << it);
+        x = a;
+        CHECK((x <<= s) == (a << s) && (x >>= s) == a, "<<= and >>= by " << s);
+
+        // the destination as one of the operands
+        x = a;
+        x += x;
+        CHECK(x == a + a, "x += x");
+        x = a;
+        x -= x;
+        CHECK(x.is_zero() && x == BigInteger(0ll), "x -= x");
+        x = a;
+        x *= x;
+        CHECK(x == ref_product(a, a), "x *= x");
+        x = a;
+        x /= x;
+        CHECK(x == BigInteger(1ll), "x /= x");
+        x = a;
+        x %= x;
+        CHECK(x.is_zero(), "x %= x");
+
+        // a small destination growing past its inline storage and a large one shrinking
+        x = BigInteger(-3ll);
+        x += a;
+        CHECK(x == a - BigInteger(3ll), "small += large");
+        x = a;
+        x -= a + BigInteger(1ll);
+        CHECK(x == BigInteger(-1ll), "cancellation down to one limb");
+    }
+
+    BigInteger a = random_number(900);
+    LimbVector limbs = a.getLimbs();
+    BigInteger b;
+    b.setLimbs(move(limbs));
+    b.setSign(1);
+    CHECK(b == a, "setLimbs from an rvalue");
+    BigInteger c = move(b);
+    CHECK(c == a, "move construction");
+    b = move(c);
+    CHECK(b == a, "move assignment");
+    swap(a, b);
+    CHECK(a == b, "swap");
+}
+
+void test_multiply() {
+    // each algorithm on its own, then the default crossovers; sizes are in limbs
+    vector<MultiplyThresholds> tiers = {{1 << 30, 1 << 30, 1 << 30}, {4, 1 << 30, 1 << 30}, {4, 12, 1 << 30}, {4, 12, 40}, {}};
+    for (const MultiplyThresholds &t : tiers) {
+        setMultiplyThresholds(t);
+        for (int it = 0; it < 60; it++) {
+            int n = 1 + rng() % 8000, m = rng() % 3 == 0 ? n : 1 + rng() % 8000;
+            BigInteger a = random_number(n, true), b = random_number(m, true);
+            CHECK(a * b == ref_product(a, b), "multiply " << n << "x" << m << " bits, karatsuba=" << t.karatsuba << " toom3=" << t.toom3 << " ntt=" << t.ntt);
+            CHECK(a.square() == ref_product(a, a), "square " << n << " bits, karatsuba=" << t.karatsuba << " toom3=" << t.toom3 << " ntt=" << t.ntt);
+            CHECK(a.mulNTT(b) == a * b, "mulNTT " << n << "x" << m << " bits");
+        }
+    }
+    setMultiplyThresholds(MultiplyThresholds());
+
+    // past the default NTT crossover
+    BigInteger a = random_number(110000), b = random_number(104000, true);
+    CHECK(a * b == ref_product(a, b), "multiply above the NTT threshold");
+    CHECK(a.square() == ref_product(a, a), "square above the NTT threshold");
+
+    a = random_number(500, true);
+    BigInteger zero(0ll);
+    CHECK((a * zero).is_zero() && (zero * a).is_zero() && zero.square().is_zero(), "multiply by zero");
+    CHECK(a * BigInteger(1ll) == a && a * BigInteger(-1ll) == BigInteger(0ll) - a, "multiply by one");
+}
+
+// truncated division: q * b + r == a with |r| < |b| and r taking the sign of a
+void check_division(const BigInteger &a, const BigInteger &b, const char *what) {
+    BigInteger q = a / b, r = a % b;
+    CHECK(q * b + r == a, what << " identity, " << a.bitLength() << "/" << b.bitLength() << " bits");
+    CHECK(r.abs() < b.abs() && (r.is_zero() || r.getSign() == a.getSign()), what << " remainder, " << a.bitLength() << "/" << b.bitLength() << " bits");
+    auto qr = divide(a, b);
+    CHECK(qr.quotient == q && qr.remainder == r, what << " divide(), " << a.bitLength() << "/" << b.bitLength() << " bits");
+    CHECK(a.mod(b) == r, what << " mod(), " << a.bitLength() << "/" << b.bitLength() << " bits");
+    BigInteger c = a;
+    c %= b;
+    CHECK(c == r, what << " %=, " << a.bitLength() << "/" << b.bitLength() << " bits");
+}
+
+void test_divide() {
+    for (int it = 0; it < 400; it++) {
+        int n = 1 + rng() % 9000, m = 1 + rng() % 9000;
+        BigInteger a = random_number(n, true), b = random_number(m, true);
+        check_division(a, b, "divide");
+        // exact and nearly exact quotients exercise the quotient-digit correction
+        BigInteger exact = b * random_number(1 + rng() % 3000, true);
+        check_division(exact, b, "exact divide");
+        check_division(exact + BigInteger(1ll), b, "nearly exact divide");
+        check_division(exact - BigInteger(1ll), b, "nearly exact divide");
+    }
+    BigInteger a = random_number(300);
+    CHECK((BigInteger(0ll) / a).is_zero() && (BigInteger(0ll) % a).is_zero(), "zero dividend");
+    CHECK(a / a == BigInteger(1ll) && (a % a).is_zero(), "divide by itself");
+    bool threw = false;
+    try {
+        a / BigInteger(0ll);
+    } catch (const char *) {
+        threw = true;
+    }
+    CHECK(threw, "division by zero throws");
+}
+
+void test_reciprocal() {
+    for (int it = 0; it < 60; it++) {
+        int m = 1 + rng() % 12000, n = m + rng() % 12000;
+        BigInteger a = random_number(n, true), b = random_number(m, true);
+        Reciprocal rec(b);
+        BigInteger q, r;
+        rec.divmod(a, q, r);
+        CHECK(q == a / b && r == a % b, "Reciprocal divmod " << n << "/" << m << " bits");
+        CHECK(rec.quotient(a) == q && rec.remainder(a) == r && rec.divisor() == b, "Reciprocal quotient/remainder " << n << "/" << m << " bits");
+        BigInteger small = random_number(1 + rng() % m, true);
+        CHECK(rec.quotient(small) == small / b && rec.remainder(small) == small % b, "Reciprocal short dividend " << m << " bits");
+    }
+    // divisors past the size where divmod_abs switches to the reciprocal
+    for (int it = 0; it < 3; it++) {
+        BigInteger b = random_number(70000 + rng() % 10000, true);
+        check_division(random_number(140000 + rng() % 20000, true), b, "large divide");
+        check_division(b * random_number(70000, true) - BigInteger(1ll), b, "large nearly exact divide");
+    }
+}
+
+// >> and << shift |x| and keep the sign
+void test_shifts() {
+    for (int it = 0; it < 400; it++) {
+        int n = 1 + rng() % 4000, s = it % 4 == 0 ? 64 * (rng() % 8) + rng() % 5 : rng() % 700;
+        BigInteger a = random_number(n, true);
+        BigInteger scale = BigInteger(1ll);
+        for (int i = 0; i < s; i++) scale = scale + scale;
+        BigInteger expect = a.abs() / scale;
+        if (a.getSign() < 0 && !expect.is_zero()) expect.setSign(-1);
+        BigInteger x = a;
+        CHECK((x >> s) == expect, "shift right " << n << " bits by " << s);
+        x = a;
+        CHECK((x << s) == a * scale, "shift left " << n << " bits by " << s);
+    }
+}
+
+void test_mod_arithmetic() {
+    for (int it = 0; it < 100; it++) {
+        BigInteger m = random_number(1 + rng() % 1500);
+        if (m == BigInteger(1ll)) continue;
+        BigInteger a = random_number(1 + rng() % 1500), b = random_number(1 + rng() % 1500);
+        BigInteger e = random_number(1 + rng() % 200);
+        CHECK(same_value(a.mulMod(b, m), a * b % m), "mulMod " << m.bitLength() << " bits");
+        CHECK(same_value(a.powMod(e, m), ref_pow_mod(a, e, m)), "powMod " << m.bitLength() << " bits");
+        BigInteger x = random_number(1 + rng() % 800, true), y = random_number(1 + rng() % 800, true);
+        BigInteger l = lcm(x, y);
+        CHECK((l % x).is_zero() && (l % y).is_zero() && l * bezout(x.abs(), y.abs()).d == (x * y).abs(), "lcm");
+    }
+}
+
+void test_montgomery() {
+    for (int it = 0; it < 150; it++) {
+        int bits = 2 + rng() % (it % 10 == 0 ? 4000 : 800);
+        BigInteger n = random_odd(bits);
+        BigInteger base = random_number(1 + rng() % (2 * bits), true), e = random_number(1 + rng() % 200);
+        if (it % 7 == 0) base = n - BigInteger(1ll);
+        BigInteger expect = ref_pow_mod(base, e, n);
+        MontgomeryContext ctx(n);
+        CHECK(ctx.modulus() == n, "Montgomery modulus");
+        CHECK(ctx.powMod(base, e) == expect, "Montgomery powMod " << bits << " bits");
+        CHECK(same_value(base.powMod(e, n), expect), "powMod with an odd modulus, " << bits << " bits");
+        CHECK(ctx.mulMod(base, e) == non_negative_mod(base * e, n), "Montgomery mulMod " << bits << " bits");
+
+        BigInteger x = non_negative_mod(base, n), y = non_negative_mod(e, n);
+        vector<TYPE> mx = ctx.toMontgomery(x), my = ctx.toMontgomery(y), r(ctx.limbs());
+        CHECK(ctx.fromMontgomery(mx) == x, "Montgomery round trip " << bits << " bits");
+        ctx.mul(r.data(), mx.data(), my.data());
+        CHECK(ctx.fromMontgomery(r) == x * y % n, "Montgomery mul " << bits << " bits");
+        ctx.mul(mx.data(), mx.data(), my.data());
+        CHECK(mx == r, "Montgomery mul in place " << bits << " bits");
+        ctx.sqr(r.data(), my.data());
+        CHECK(ctx.fromMontgomery(r) == y * y % n, "Montgomery sqr " << bits << " bits");
+        CHECK(ctx.fromMontgomery(ctx.pow(ctx.toMontgomery(x), e)) == expect, "Montgomery pow " << bits << " bits");
+    }
+}
+
+// window sizes grow with the exponent, so the exponents run up to 4096 bits
+void test_windowed_pow() {
+    for (int it = 0; it < 40; it++) {
+        int bits = 2 + rng() % 1200, ebits = it < 4 ? it : 1 + rng() % (it % 8 == 0 ? 4096 : 1500);
+        BigInteger n = random_odd(bits), e = ebits ? random_number(ebits) : BigInteger(0ll);
+        BigInteger base = random_number(1 + rng() % bits) % n, even = n + BigInteger(1ll);
+        BigInteger expect = ref_pow_mod(base, e, n);
+        MontgomeryContext ctx(n);
+        CHECK(ctx.powMod(base, e) == expect, "sliding-window powMod " << bits << " bits, exponent " << ebits);
+        CHECK(same_value(BarrettContext(even).powMod(base, e), ref_pow_mod(base, e, even)), "sliding-window Barrett powMod " << bits << " bits, exponent " << ebits);
+        CHECK(same_value(base.powModConstTime(e, n), expect), "powModConstTime " << bits << " bits, exponent " << ebits);
+        CHECK(ctx.fromMontgomery(ctx.powConstTime(ctx.toMontgomery(base), e)) == expect, "powConstTime " << bits << " bits, exponent " << ebits);
+    }
+}
+
+void test_fixed_base() {
+    for (int it = 0; it < 24; it++) {
+        int bits = 2 + rng() % 1100, maxBits = 1 + rng() % 1500;
+        BigInteger n = random_odd(bits), base = random_number(1 + rng() % bits) % n;
+        size_t entry = MontgomeryContext(n).limbs() * sizeof(TYPE);
+        // from below the two-entry minimum comb, through less than one 2^h row, to the default
+        size_t budgets[] = {1, 3 * entry, 40 * entry, 1 << 20};
+        size_t budget = budgets[it % 4];
+        FixedBasePowContext fb(base, n, maxBits, budget);
+        CHECK(fb.tableBytes() <= max(budget, 2 * entry), "table of " << fb.tableBytes() << " bytes for a budget of " << budget);
+        if (budget < 2 * entry) {
+            CHECK(fb.tableBytes() == 2 * entry, "a budget below two entries gets the two-entry comb");
+        }
+        for (int ebits : {0, 1, maxBits - 1, maxBits, maxBits + 1, (int)(1 + rng() % maxBits)}) {
+            BigInteger e = ebits ? random_number(ebits) : BigInteger(0ll);
+            if (ebits == maxBits && rng() % 2) {
+                BigInteger one(1ll);
+                e = (one << maxBits) - one; // all ones
+            }
+            CHECK(fb.powMod(e) == ref_pow_mod(base, e, n), "fixed-base powMod " << bits << " bits, exponent " << e.bitLength() << " of " << maxBits << ", budget " << budget);
+        }
+        BigInteger e = random_number(1 + rng() % maxBits);
+        if (bezout(base, n).d == BigInteger(1ll)) {
+            CHECK(fb.powMod(BigInteger(0ll) - e) * fb.powMod(e) % n == BigInteger(1ll), "fixed-base powMod with a negative exponent");
+        }
+    }
+}
+
+void test_barrett() {
+    for (int it = 0; it < 150; it++) {
+        int bits = 2 + rng() % (it % 10 == 0 ? 4000 : 800);
+        BigInteger m = random_number(bits);
+        BarrettContext ctx(m);
+        CHECK(ctx.modulus() == m, "Barrett modulus");
+        BigInteger x = random_number(1 + rng() % (2 * bits), true), y = random_number(1 + rng() % bits, true);
+        CHECK(ctx.reduce(x) == non_negative_mod(x, m), "Barrett reduce " << bits << " bits");
+        BigInteger a = non_negative_mod(x, m), b = non_negative_mod(y, m), e = random_number(1 + rng() % 200);
+        CHECK(same_value(addMod(a, b, ctx), (a + b) % m), "Barrett addMod " << bits << " bits");
+        CHECK(same_value(mulMod(a, b, ctx), a * b % m), "Barrett mulMod " << bits << " bits");
+        BigInteger expect = ref_pow_mod(a, e, m);
+        CHECK(same_value(ctx.powMod(a, e), expect), "Barrett powMod " << bits << " bits");
+        CHECK(same_value(a.powMod(e, m), expect), "powMod with any modulus, " << bits << " bits");
+    }
+}
+
+// trial division, for values up to 64 bits
+bool is_prime_small(unsigned long long n) {
+    if (n < 2) return false;
+    for (unsigned long long d = 2; d * d <= n; d++) {
+        if (n % d == 0) return false;
+    }
+    return true;
+}
+
+unsigned long long to_u64(const BigInteger &x) {
+    return stoull(x.toString(), nullptr, 2);
+}
+
+void check_generated_prime(const BigInteger &p, int bits) {
+    CHECK(p.bitLength() == bits, "prime of " << p.bitLength() << " bits, asked for " << bits);
+    PrimalityResult r = primality_test(p);
+    CHECK(r.probablePrime && r.witness.is_zero(), "generated " << bits << "-bit prime " << p.toDecimal() << " passes primality_test");
+    if (bits <= 40) {
+        CHECK(is_prime_small(to_u64(p)), "generated " << bits << "-bit prime " << p.toDecimal() << " by trial division");
+    }
+}
+
+void check_rsa_key(const RsaPrivateKey &key, int bits) {
+    const BigInteger &n = key.modulus(), &e = key.publicExponent(), &d = key.privateExponent();
+    CHECK(n.bitLength() == bits, "RSA modulus of " << n.bitLength() << " bits, asked for " << bits);
+    for (int it = 0; it < 8; it++) {
+        BigInteger m = random_number(bits - 1) % n;
+        if (it == 0) m = BigInteger(0ll);
+        if (it == 1) m = BigInteger(1ll);
+        if (it == 2) m = n - BigInteger(1ll);
+        BigInteger c = key.encrypt(m);
+        CHECK(same_value(c, ref_pow_mod(m, e, n)), "RSA encrypt " << bits);
+        CHECK(same_value(key.decrypt(c), m), "RSA decrypt " << bits);
+        CHECK(same_value(key.decrypt(c, true), m), "RSA parallel decrypt " << bits);
+        CHECK(same_value(key.sign(m), ref_pow_mod(m, d, n)), "RSA sign " << bits);
+        CHECK(same_value(key.sign(m, true), key.sign(m)), "RSA parallel sign " << bits);
+    }
+}
+
+void test_rsa() {
+    for (int bits : {64, 256, 512, 1024}) {
+        check_rsa_key(RsaPrivateKey::generate(bits), bits);
+    }
+    // a key from known primes and a small public exponent
+    BigInteger p = decimal("170141183460469231731687303715884105727"), q = decimal("2305843009213693951");
+    RsaPrivateKey key(p, q, BigInteger(17ll));
+    CHECK(key.modulus() == p * q && same_value(key.privateExponent() * BigInteger(17ll) % lcm(p - BigInteger(1ll), q - BigInteger(1ll)), BigInteger(1ll)), "RSA key from primes");
+    check_rsa_key(key, (p * q).bitLength());
+
+    // the CRT recombination takes m1 - m2 with a masked sub, so both signs of the difference
+    // must come out right, with the primes in either order and of unequal limb counts
+    RsaPrivateKey swapped(q, p, BigInteger(17ll));
+    const BigInteger &n = key.modulus();
+    int seen[2] = {0, 0};
+    for (int it = 0; it < 40; it++) {
+        // m mod p below m mod q needs m just above a multiple of p
+        BigInteger m = it % 2 ? random_number(1 + rng() % (n.bitLength() - 1)) % n : (p * (random_number(60) % q) + BigInteger((ll)(rng() % 1000))) % n;
+        seen[m % p < m % q]++;
+        BigInteger c = key.encrypt(m);
+        for (const RsaPrivateKey *k : {&key, &swapped}) {
+            CHECK(same_value(k->decrypt(c), m) && same_value(k->decrypt(c, true), m), "CRT decrypt with m mod p " << (m % p < m % q ? "<" : ">=") << " m mod q");
+        }
+        // ciphertexts outside [0, n) reduce like their residue
+        CHECK(same_value(key.decrypt(c + n * BigInteger(3ll)), m) && same_value(key.decrypt(c - n, true), m), "decrypt of an unreduced ciphertext");
+    }
+    CHECK(seen[0] && seen[1], "both orders of the CRT halves were tried");
+
+    // e = 3 divides p - 1 for about half the primes, so generate has to retry
+    for (int it = 0; it < 4; it++) {
+        RsaPrivateKey small = RsaPrivateKey::generate(128, BigInteger(3ll));
+        CHECK(small.publicExponent() == BigInteger(3ll), "RSA key with e = 3");
+        check_rsa_key(small, 128);
+    }
+    for (ll e : {2, 65536, 1, 0, -3}) {
+        CHECK(throws([&] { RsaPrivateKey::generate(128, BigInteger(e)); }), "RSA generate with e = " << e << " throws");
+    }
+}
+
+void test_prime_generation() {
+    for (int bits : {3, 5, 8, 12, 16, 20, 31, 40, 64, 128, 512, 1024}) {
+        check_generated_prime(generate_large_prime(bits), bits);
+    }
+    for (int threads : {0, 2, 4}) {
+        check_generated_prime(generate_large_prime(256, threads), 256);
+        for (int bits : {16, 256, 1024}) {
+            vector<BigInteger> primes = generate_large_primes(bits, 6, threads);
+            CHECK(primes.size() == 6, primes.size() << " primes of " << bits << " bits on " << threads << " threads, asked for 6");
+            for (size_t i = 0; i < primes.size(); i++) {
+                check_generated_prime(primes[i], bits);
+                for (size_t j = 0; j < i; j++) {
+                    CHECK(primes[i] != primes[j], "generate_large_primes returned " << primes[i].toDecimal() << " twice");
+                }
+            }
+        }
+    }
+    check_rsa_key(RsaPrivateKey::generate(512, BigInteger(65537ll), 2), 512);
+}
+
+void test_miller_rabin() {
+    // including the Mersenne primes 2^61 - 1 and 2^127 - 1
+    for (string p : {"547", "7919", "65537", "2305843009213693951", "170141183460469231731687303715884105727"}) {
+        CHECK(Miller_Rabin_check(decimal(p)), "prime " << p);
+    }
+    // Carmichael numbers, 2^61 + 1 and a product of two large primes
+    BigInteger semiprime = decimal("2305843009213693951") * decimal("170141183460469231731687303715884105727");
+    for (BigInteger c : {decimal("561"), decimal("41041"), decimal("825265"), decimal("2305843009213693953"), semiprime}) {
+        CHECK(!Miller_Rabin_check(c), "composite " << c.toDecimal());
+    }
+}
+
+// Euclid with plain division
+BigInteger ref_gcd(BigInteger x, BigInteger y) {
+    x = x.abs(), y = y.abs();
+    while (!y.is_zero()) {
+        BigInteger r = x % y;
+        x = y;
+        y = r;
+    }
+    return x;
+}
+
+void check_gcd(const BigInteger &x, const BigInteger &y) {
+    BigInteger g = ref_gcd(x, y);
+    CHECK(gcd(x, y) == g, "gcd of " << x.bitLength() << " and " << y.bitLength() << " bits");
+    auto bz = bezout(x, y);
+    CHECK(bz.d == g && bz.a * x + bz.b * y == g, "bezout of " << x.bitLength() << " and " << y.bitLength() << " bits");
+    // the cofactors stay below the other input divided by the gcd
+    if (!g.is_zero() && !x.is_zero() && !y.is_zero()) {
+        CHECK(bz.a.abs() <= (y / g).abs() && bz.b.abs() <= (x / g).abs(), "bezout cofactor bounds of " << x.bitLength() << " and " << y.bitLength() << " bits");
+    }
+}
+
+void test_gcd() {
+    for (int it = 0; it < 200; it++) {
+        // every tenth pair goes past the half-gcd threshold
+        int n = 1 + rng() % (it % 10 == 0 ? 20000 : 2000), m = 1 + rng() % (it % 10 == 0 ? 20000 : 2000);
+        BigInteger common = random_number(1 + rng() % 300);
+        check_gcd(random_number(n, true), random_number(m, true));
+        check_gcd(random_number(n, true) * common, random_number(m, true) * common);
+    }
+    BigInteger a = random_number(7000, true), zero(0ll);
+    check_gcd(a, zero);
+    check_gcd(zero, a);
+    check_gcd(a, a);
+    check_gcd(a, a * random_number(3000, true));
+    auto bz = bezout(zero, zero);
+    CHECK(bz.d.is_zero() && gcd(zero, zero).is_zero(), "gcd of zeros");
+    BigInteger fib1(1ll), fib2(1ll);
+    for (int i = 0; i < 9000; i++) {
+        BigInteger next = fib1 + fib2;
+        fib1 = fib2;
+        fib2 = next;
+    }
+    check_gcd(fib2, fib1); // consecutive Fibonacci numbers take the most steps
+}
+
+void test_mod_inverse() {
+    for (int it = 0; it < 200; it++) {
+        int bits = 2 + rng() % (it % 10 == 0 ? 4000 : 700);
+        BigInteger n = it % 2 ? random_odd(bits) : random_number(bits);
+        BigInteger a = random_number(1 + rng() % (bits + 100), true);
+        if (gcd(a, n) != BigInteger(1ll)) {
+            CHECK(throws([&] { mod_inverse(a, n); }), "mod_inverse of a non-invertible value throws");
+            continue;
+        }
+        BigInteger inv = mod_inverse(a, n);
+        CHECK(inv.getSign() >= 0 && inv < n && non_negative_mod(a * inv, n) == non_negative_mod(BigInteger(1ll), n), "mod_inverse " << bits << " bits");
+        CHECK(mod_inverse(a, BigInteger(0ll) - n) == inv, "mod_inverse with a negative modulus");
+        if (n.is_even() || n == BigInteger(1ll)) continue;
+        BigInteger r = non_negative_mod(a, n);
+        CHECK(mod_inverse_consttime(r, n) == inv, "mod_inverse_consttime " << bits << " bits");
+    }
+
+    for (bool odd : {true, false}) {
+        BigInteger n = odd ? random_odd(1500) : random_number(1500);
+        vector<BigInteger> values;
+        while (values.size() < 40) {
+            BigInteger a = random_number(1 + rng() % 1500);
+            if (gcd(a, n) == BigInteger(1ll)) values.push_back(a);
+        }
+        vector<BigInteger> inverses = mod_inverse_batch(values, n);
+        CHECK(inverses.size() == values.size(), "mod_inverse_batch size");
+        for (size_t i = 0; i < values.size() && i < inverses.size(); i++) {
+            CHECK(inverses[i] == mod_inverse(values[i], n), "mod_inverse_batch element " << i << (odd ? ", odd modulus" : ", even modulus"));
+        }
+        values.push_back(n * BigInteger(3ll));
+        CHECK(throws([&] { mod_inverse_batch(values, n); }), "mod_inverse_batch with a non-invertible element throws");
+    }
+    CHECK(mod_inverse_batch({}, random_odd(100)).empty(), "empty mod_inverse_batch");
+    CHECK(throws([] { mod_inverse_consttime(BigInteger(3ll), BigInteger(10ll)); }), "mod_inverse_consttime with an even modulus throws");
+
+    // the secret is not reduced, so values outside [0, n) are rejected instead
+    for (int it = 0; it < 40; it++) {
+        BigInteger n = random_odd(2 + rng() % 1000), one(1ll);
+        BigInteger r = random_number(1 + rng() % n.bitLength()) % n;
+        CHECK(throws([&] { mod_inverse_consttime(BigInteger(0ll) - r - one, n); }), "mod_inverse_consttime of a negative value throws");
+        CHECK(throws([&] { mod_inverse_consttime(n, n); }) && throws([&] { mod_inverse_consttime(n + r, n); }), "mod_inverse_consttime of a value >= n throws");
+        CHECK(throws([&] { mod_inverse_consttime(n * n + one, n); }), "mod_inverse_consttime of a longer value throws");
+        if (gcd(n - one, n) == one && n != one) {
+            CHECK(same_value(mod_inverse_consttime(n - one, n), n - one), "mod_inverse_consttime of n - 1");
+        }
+    }
+}
+
+void test_decimal() {
+    for (int it = 0; it < 150; it++) {
+        // a few values past the divide-and-conquer and cached-power sizes
+        int bits = it < 64 ? it + 1 : 1 + rng() % (it % 10 == 0 ? 80000 : 3000);
+        BigInteger x = random_number(bits, true);
+        string dec = ref_decimal(x);
+        CHECK(x.toDecimal() == dec, "toDecimal " << bits << " bits");
+        CHECK(BigInteger::fromDecimal(dec) == x, "fromDecimal " << bits << " bits");
+    }
+    // powers of ten and their neighbours sit on the 18-digit chunk boundaries
+    BigInteger ten(10ll), power(1ll), one(1ll);
+    for (int digits = 1; digits <= 400; digits++) {
+        power = power * ten;
+        for (BigInteger x : {power - one, power, power + one}) {
+            CHECK(x.toDecimal() == ref_decimal(x) && BigInteger::fromDecimal(ref_decimal(x)) == x, "decimal around 10^" << digits);
+        }
+    }
+    CHECK(BigInteger(0ll).toDecimal() == "0" && BigInteger::fromDecimal("0").is_zero(), "decimal zero");
+    CHECK(BigInteger::fromDecimal("-0") == BigInteger(0ll) && BigInteger::fromDecimal("+000123") == BigInteger(123ll), "decimal signs and leading zeros");
+    CHECK(BigInteger::fromDecimal("-" + string(50, '0') + "42") == BigInteger(-42ll), "negative decimal with leading zeros");
+    for (string bad : {"", "-", "+", "12a3", " 1", "1 ", "0x10", "--1"}) {
+        CHECK(throws([&] { BigInteger::fromDecimal(bad); }), "fromDecimal(\"" << bad << "\") throws");
+    }
+}
+
+// lowercase hex digits of x straight from its 32-bit words
+string ref_hex(const BigInteger &x) {
+    Words w = to_words(x);
+    string s;
+    for (int i = (int)w.size() * 8 - 1; i >= 0; i--) {
+        s += "0123456789abcdef"[w[i / 8] >> (i % 8 * 4) & 15];
+    }
+    size_t first = s.find_first_not_of('0');
+    return first == string::npos ? "0" : s.substr(first);
+}
+
+void test_hex_bytes() {
+    for (int it = 0; it < 200; it++) {
+        int bits = it < 130 ? it + 1 : 1 + rng() % 20000;
+        BigInteger x = random_number(bits, true);
+        string hex = ref_hex(x);
+        bool negative = x.getSign() < 0;
+        CHECK(x.toHex() == (negative ? "-" : "") + hex, "toHex " << bits << " bits");
+        CHECK(BigInteger::fromHex((negative ? "-0x" : "0X") + hex) == x, "fromHex " << bits << " bits");
+        string upper = hex;
+        for (char &c : upper) c = toupper(c);
+        CHECK(BigInteger::fromHex((negative ? "-" : "+") + upper) == x, "fromHex uppercase " << bits << " bits");
+
+        // padded to a buffer larger than needed
+        string padded(hex.size() + 5, '?');
+        x.toHex(span<char>(padded));
+        CHECK(padded == string(5, '0') + hex, "toHex into a padded buffer");
+
+        // bytes are the magnitude, read off the hex digits
+        BigInteger mag = BigInteger::fromHex(hex);
+        vector<uint8_t> big = mag.toBytes();
+        CHECK(big.size() == (hex.size() + 1) / 2 && big.size() == x.byteLength(), "byteLength " << bits << " bits");
+        string even = hex.size() % 2 ? "0" + hex : hex;
+        bool match = true;
+        for (size_t i = 0; i < big.size(); i++) {
+            match = match && big[i] == stoi(even.substr(2 * i, 2), nullptr, 16);
+        }
+        CHECK(match, "toBytes big endian " << bits << " bits");
+        CHECK(x.toBytes() == big, "toBytes ignores the sign");
+        vector<uint8_t> little = x.toBytes(ByteOrder::LittleEndian);
+        CHECK(equal(little.begin(), little.end(), big.rbegin()), "toBytes little endian " << bits << " bits");
+        CHECK(BigInteger::fromBytes(big) == mag && BigInteger::fromBytes(little, ByteOrder::LittleEndian) == mag, "fromBytes " << bits << " bits");
+
+        vector<uint8_t> wide(big.size() + 3, 0xAA);
+        x.toBytes(span<uint8_t>(wide));
+        CHECK(wide[0] == 0 && wide[1] == 0 && wide[2] == 0 && equal(big.begin(), big.end(), wide.begin() + 3), "toBytes into a padded buffer");
+        x.toBytes(span<uint8_t>(wide), ByteOrder::LittleEndian);
+        CHECK(equal(little.begin(), little.end(), wide.begin()) && wide.back() == 0, "little endian padded buffer");
+        CHECK(BigInteger::fromBytes(wide, ByteOrder::LittleEndian) == mag, "fromBytes with leading zero bytes");
+    }
+
+    BigInteger zero(0ll);
+    CHECK(zero.toHex() == "0" && BigInteger::fromHex("-0x000").is_zero(), "hex zero");
+    CHECK(zero.byteLength() == 0 && zero.toBytes().empty() && BigInteger::fromBytes(vector<uint8_t>()).is_zero(), "bytes of zero");
+    for (string bad : {"", "-", "0x", "-0x", "12g4", "0x 1", "1-2", "0xx1"}) {
+        CHECK(throws([&] { BigInteger::fromHex(bad); }), "fromHex(\"" << bad << "\") throws");
+    }
+    BigInteger x = BigInteger::fromHex("1234567");
+    char small[6];
+    CHECK(throws([&] { x.toHex(span<char>(small)); }), "toHex into a short buffer throws");
+    uint8_t three[3];
+    CHECK(throws([&] { x.toBytes(span<uint8_t>(three)); }), "toBytes into a short buffer throws");
+}
+
+// digits of |x| in the given base by repeated short division of its words, random case
+string ref_radix(const BigInteger &x, int base) {
+    Words w = to_words(x);
+    string s;
+    while (!w.empty()) {
+        uint64_t rem = 0;
+        for (int i = (int)w.size() - 1; i >= 0; i--) {
+            uint64_t cur = rem << 32 | w[i];
+            w[i] = (uint32_t)(cur / base);
+            rem = cur % base;
+        }
+        while (!w.empty() && w.back() == 0) w.pop_back();
+        s += rem < 10 ? char('0' + rem) : char((rng() % 2 ? 'a' : 'A') + rem - 10);
+    }
+    if (s.empty()) s = "0";
+    reverse(s.begin(), s.end());
+    return s;
+}
+
+void test_radix() {
+    for (int base = 2; base <= 36; base++) {
+        for (int it = 0; it < 12; it++) {
+            // a couple of strings long enough to take the split path
+            int bits = it < 8 ? 1 + rng() % 300 : 1 + rng() % 12000;
+            BigInteger x = random_number(bits, true);
+            string digits = ref_radix(x, base);
+            CHECK(BigInteger(digits, base, x.getSign()) == x, "base " << base << ", " << bits << " bits");
+            CHECK(BigInteger("000" + digits, base, x.getSign()) == x, "base " << base << " with leading zeros");
+        }
+        BigInteger zero(string(40, '0'), base, -1);
+        CHECK(zero.is_zero() && zero.getSign() == 1, "negative zero in base " << base);
+        CHECK(BigInteger(base == 36 ? "z" : "1", base, 1) == BigInteger(base == 36 ? 35ll : 1ll), "single digit in base " << base);
+
+        // the first digit past the base is rejected in either case
+        string bad(1, base < 10 ? char('0' + base) : char('a' + base - 10));
+        if (base < 36) {
+            CHECK(throws([&] { BigInteger("10" + bad, base, 1); }), "digit " << bad << " in base " << base << " throws");
+            bad[0] = toupper(bad[0]);
+            CHECK(throws([&] { BigInteger(bad + "1", base, 1); }), "digit " << bad << " in base " << base << " throws");
+        }
+        CHECK(throws([&] { BigInteger("1-1", base, 1); }), "sign inside digits throws in base " << base);
+    }
+    CHECK(BigInteger("Ff", 16, 1) == BigInteger(255ll) && BigInteger("zZ", 36, -1) == BigInteger(-1295ll), "mixed case digits");
+    for (int base : {-10, 0, 1, 37, 64}) {
+        CHECK(throws([&] { BigInteger("101", base, 1); }), "base " << base << " throws");
+    }
+}
+
+// the fixed-width arithmetic is usable in constant expressions
+constexpr FixedBigInt<128> fixed_max = FixedBigInt<128>(0) - FixedBigInt<128>(1);
+static_assert(fixed_max + FixedBigInt<128>(1) == FixedBigInt<128>(0), "FixedBigInt wraps around");
+static_assert((FixedBigInt<128>(1) << 127 >> 63).limbs[1] == 1 && fixed_max.bitLength() == 128, "FixedBigInt shifts");
+static_assert(mul_wide(fixed_max, fixed_max).limbs == array<ull, 4>{1, 0, ~0ull - 1, ~0ull}, "FixedBigInt mul_wide");
+static_assert(FixedBigInt<64>(3) * FixedBigInt<64>(5) == FixedBigInt<64>(15) && FixedBigInt<64>(2) < FixedBigInt<64>(3), "FixedBigInt mul and compare");
+
+template <int Bits>
+void test_fixed_width() {
+    using Int = FixedBigInt<Bits>;
+    BigInteger R = BigInteger(1ll) << Bits;
+    for (int it = 0; it < 60; it++) {
+        BigInteger a = random_number(1 + rng() % Bits), b = it % 10 == 0 ? a : random_number(1 + rng() % Bits);
+        int s = rng() % (Bits + 10);
+        Int x = Int::fromBigInteger(a), y = Int::fromBigInteger(b);
+        CHECK(x.toBigInteger() == a && x.bitLength() == a.bitLength() && x.bit(0) == (int)(a.getLimbs()[0] & 1), "FixedBigInt<" << Bits << "> conversion");
+        CHECK((x + y).toBigInteger() == non_negative_mod(a + b, R), "FixedBigInt<" << Bits << "> add");
+        CHECK((x - y).toBigInteger() == non_negative_mod(a - b, R), "FixedBigInt<" << Bits << "> sub");
+        CHECK((x * y).toBigInteger() == non_negative_mod(a * b, R), "FixedBigInt<" << Bits << "> mul");
+        CHECK(mul_wide(x, y).toBigInteger() == ref_product(a, b), "FixedBigInt<" << Bits << "> mul_wide");
+        CHECK((x << s).toBigInteger() == non_negative_mod(a << s, R) && (x >> s).toBigInteger() == (a >> s), "FixedBigInt<" << Bits << "> shift by " << s);
+        CHECK((x < y) == (a < b) && (x == y) == (a == b) && (x > y) == (b < a), "FixedBigInt<" << Bits << "> compare");
+        Int z = x;
+        z += y;
+        z -= y;
+        CHECK(z == x, "FixedBigInt<" << Bits << "> += and -=");
+    }
+
+    for (int it = 0; it < 12; it++) {
+        BigInteger n = it == 0 ? BigInteger(3ll) : random_odd(it % 3 == 0 ? 2 + rng() % (Bits - 1) : Bits);
+        FixedMontgomery<Bits> mont(n);
+        for (int j = 0; j < 8; j++) {
+            BigInteger a = random_number(1 + rng() % Bits) % n, b = random_number(1 + rng() % Bits) % n;
+            BigInteger e = j == 0 ? BigInteger(0ll) : random_number(1 + rng() % Bits);
+            Int x = mont.toMontgomery(Int::fromBigInteger(a)), y = mont.toMontgomery(Int::fromBigInteger(b));
+            CHECK(same_value(mont.fromMontgomery(mont.mul(x, y)).toBigInteger(), a * b % n), "FixedMontgomery<" << Bits << "> mul");
+            CHECK(same_value(mont.fromMontgomery(mont.sqr(x)).toBigInteger(), a * a % n), "FixedMontgomery<" << Bits << "> sqr");
+            CHECK(same_value(mont.fromMontgomery(mont.add(x, y)).toBigInteger(), (a + b) % n), "FixedMontgomery<" << Bits << "> add");
+            CHECK(same_value(mont.fromMontgomery(mont.sub(x, y)).toBigInteger(), non_negative_mod(a - b, n)), "FixedMontgomery<" << Bits << "> sub");
+            BigInteger expect = a.powMod(e, n);
+            CHECK(same_value(mont.powMod(a, e), expect), "FixedMontgomery<" << Bits << "> powMod");
+            CHECK(same_value(mont.fromMontgomery(mont.pow(x, Int::fromBigInteger(e))).toBigInteger(), expect), "FixedMontgomery<" << Bits << "> pow");
+        }
+    }
+
+    CHECK(throws([&] { Int::fromBigInteger(R); }) && throws([&] { Int::fromBigInteger(BigInteger(-1ll)); }), "FixedBigInt<" << Bits << "> out of range throws");
+    CHECK(throws([&] { FixedMontgomery<Bits> m(R - BigInteger(2ll)); }) && throws([&] { FixedMontgomery<Bits> m(BigInteger(1ll)); }), "FixedMontgomery<" << Bits << "> rejects bad moduli");
+}
+
+void test_fixed_bigint() {
+    test_fixed_width<64>();
+    test_fixed_width<128>();
+    test_fixed_width<256>();
+    test_fixed_width<1024>();
+
+    // exponents past 1793 bits, where window_size() asks for more than the fixed table holds
+    int widths[] = {1, 7, 8, 25, 26, 81, 82, 241, 242, 673, 674, 1793, 1794, 4096};
+    int expect[] = {1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7};
+    for (int i = 0; i < 14; i++) {
+        CHECK(window_size(widths[i]) == expect[i], "window_size(" << widths[i] << ")");
+    }
+    for (int it = 0; it < 3; it++) {
+        BigInteger n = random_odd(2048), base = random_number(2000) % n, e = random_number(1794 + rng() % 254);
+        FixedMontgomery<2048> mont(n);
+        CHECK(same_value(mont.powMod(base, e), base.powMod(e, n)), "FixedMontgomery<2048> powMod, exponent " << e.bitLength() << " bits");
+    }
+}
+
+// the constant-time path runs CIOS at every size and reduces with masks, so the edge cases are
+// moduli near a power of 2^64, bases far above n or negative, and sums right at n
+void test_constant_time() {
+    for (int it = 0; it < 60; it++) {
+        int limbs = 1 + rng() % (it % 6 == 0 ? 80 : 20);
+        BigInteger n = it % 3 == 0 ? BigInteger(string(64 * limbs, '1')) : random_odd(64 * limbs - rng() % 64);
+        BigInteger one(1ll);
+        MontgomeryContext ctx(n);
+        BigInteger e = random_number(1 + rng() % 300);
+        vector<BigInteger> bases = {BigInteger(0ll), one, n - one, n, n + one, random_number(3 * n.bitLength(), true), BigInteger(0ll) - n - one};
+        for (const BigInteger &base : bases) {
+            BigInteger expect = ref_pow_mod(base, e, n);
+            CHECK(same_value(ctx.powModConstTime(base, e), expect), "MontgomeryContext::powModConstTime, " << limbs << " limbs");
+            CHECK(same_value(base.powModConstTime(e, n), expect), "BigInteger::powModConstTime, " << limbs << " limbs");
+        }
+        CHECK(same_value(ctx.powModConstTime(bases[5], BigInteger(0ll)), one), "powModConstTime with a zero exponent");
+
+        // a + b lands just below, at and just above n
+        BigInteger a = random_number(1 + rng() % n.bitLength()) % n;
+        for (BigInteger b : {n - a - one, n - a, n - a + one}) {
+            if (b.getSign() < 0 || !(b < n)) continue;
+            vector<TYPE> ma = ctx.toMontgomery(a), mb = ctx.toMontgomery(b), r(ctx.limbs());
+            ctx.add(r.data(), ma.data(), mb.data());
+            CHECK(same_value(ctx.fromMontgomery(r), (a + b) % n), "masked add near n, " << limbs << " limbs");
+            ctx.sub(r.data(), ma.data(), mb.data());
+            CHECK(same_value(ctx.fromMontgomery(r), non_negative_mod(a - b, n)), "masked sub, " << limbs << " limbs");
+        }
+    }
+    CHECK(throws([] { BigInteger(3ll).powModConstTime(BigInteger(5ll), BigInteger(10ll)); }), "powModConstTime with an even modulus throws");
+    CHECK(throws([] { BigInteger(3ll).powModConstTime(BigInteger(-5ll), BigInteger(11ll)); }), "powModConstTime with a negative exponent throws");
+}
+
+// the deprecated accessors still speak the original 61-bit digits
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+void test_legacy_digits() {
+    for (int it = 0; it < 200; it++) {
+        BigInteger a = random_number(1 + rng() % 2000, true);
+        vector<TYPE> digits = a.getDigits();
+        const vector<TYPE> &bound = a.getDigits();
+        CHECK(bound == digits, "getDigits bound to a const reference");
+        BigInteger ref(0ll);
+        bool inRange = true;
+        for (int i = (int)digits.size() - 1; i >= 0; i--) {
+            inRange = inRange && digits[i] >> LEGACY_BIT_PER_DIGIT == 0;
+            ref = (ref << LEGACY_BIT_PER_DIGIT) + BigInteger((ll)digits[i]);
+        }
+        CHECK(inRange && ref == a.abs() && digits.back() != 0, "getDigits of " << a.bitLength() << " bits");
+        BigInteger back;
+        back.setSign(a.getSign());
+        digits.push_back(0);
+        back.setDigits(digits);
+        CHECK(back == a, "setDigits keeps the sign and trims, " << a.bitLength() << " bits");
+    }
+    CHECK(BigInteger(0ll).getDigits() == vector<TYPE>{0}, "getDigits of zero");
+    BigInteger x;
+    x.setSign(1);
+    CHECK(throws([&] { x.setDigits({1, 1ull << LEGACY_BIT_PER_DIGIT}); }), "setDigits rejects a digit of 2^61");
+}
+#pragma GCC diagnostic pop
+
+void check_primality(const BigInteger &n, bool prime, PrimalityReason reason) {
+    PrimalityResult r = primality_test(n);
+    CHECK(r.probablePrime == prime && r.reason == reason, "primality_test(" << n.toDecimal() << ") gave " << r.probablePrime << " with reason " << (int)r.reason);
+    CHECK(Miller_Rabin_check(n) == prime && is_probable_prime(n) == prime, "Miller_Rabin_check and is_probable_prime agree on " << n.toDecimal());
+    if (prime) {
+        CHECK(r.witness.is_zero(), "no witness for the prime " << n.toDecimal());
+    }
+}
+
+void test_primality() {
+    BigInteger one(1ll);
+    for (BigInteger n : {BigInteger(-7ll), BigInteger(0ll), one}) {
+        check_primality(n, false, PrimalityReason::TooSmall);
+    }
+    for (ll p : {2, 3, 5, 541}) {
+        check_primality(BigInteger(p), true, PrimalityReason::SmallPrime);
+    }
+    // 547 is the first prime past the table, 292681 = 541^2
+    for (ll p : {547, 7919, 292661}) {
+        check_primality(BigInteger(p), true, PrimalityReason::TrialDivision);
+    }
+    BigInteger mersenne61 = decimal("2305843009213693951"), mersenne127 = decimal("170141183460469231731687303715884105727");
+    for (BigInteger f : {BigInteger(3ll), BigInteger(541ll)}) {
+        PrimalityResult r = primality_test(mersenne127 * f);
+        CHECK(!r.probablePrime && r.reason == PrimalityReason::SmallFactor && r.witness == f, "small factor " << f.toDecimal());
+    }
+
+    // 547 * 557 has no factor in the table; 3825123056546413051 is a strong pseudoprime to
+    // bases 2..23 that base 37 catches below 2^78
+    check_primality(BigInteger(547ll * 557), false, PrimalityReason::MillerRabin);
+    PrimalityResult r = primality_test(decimal("3825123056546413051"));
+    CHECK(!r.probablePrime && r.reason == PrimalityReason::MillerRabin && r.witness == BigInteger(37ll), "3825123056546413051 caught by base 37");
+
+    // 318665857834031151167461 passes every base up to 37; at 79 bits it goes through
+    // Baillie-PSW, where the Lucas test rejects it
+    check_primality(decimal("318665857834031151167461"), false, PrimalityReason::Lucas);
+
+    // the largest prime below 2^78 is proved by the fixed bases, the smallest above it by Baillie-PSW
+    check_primality(decimal("302231454903657293676533"), true, PrimalityReason::Passed);
+    check_primality(decimal("302231454903657293676551"), true, PrimalityReason::Passed);
+    check_primality(mersenne61, true, PrimalityReason::Passed);
+    check_primality(mersenne127, true, PrimalityReason::Passed);
+    check_primality(mersenne61 * mersenne127, false, PrimalityReason::MillerRabin);
+
+    // a square only reaches the PerfectSquare check above 2^78 if it is also a strong
+    // pseudoprime to base 2, which needs every prime factor to be a Wieferich prime (only 1093
+    // and 3511 are known), so the isqrt behind that check is tested directly
+    for (int it = 0; it < 200; it++) {
+        BigInteger r = random_number(1 + rng() % 3000), one(1ll);
+        BigInteger square = r * r;
+        CHECK(isqrt(square) == r && isqrt(square + r + r) == r && (r == one || isqrt(square - one) == r - one), "isqrt around the square of " << r.bitLength() << " bits");
+    }
+    CHECK(isqrt(BigInteger(0ll)).is_zero() && isqrt(BigInteger(1ll)) == BigInteger(1ll) && isqrt(BigInteger(3ll)) == BigInteger(1ll), "isqrt of 0, 1 and 3");
+    for (ll p : {1093, 3511}) {
+        PrimalityResult r = primality_test(BigInteger(p * p));
+        CHECK(!r.probablePrime && r.reason == PrimalityReason::MillerRabin && r.witness == BigInteger(3ll), "the base-2 strong pseudoprime " << p << "^2 is caught by base 3");
+    }
+
+    // perfect squares are composite, whichever check finds it
+    for (BigInteger root : {BigInteger(547ll), mersenne61, mersenne127, mersenne61 * BigInteger(1093ll)}) {
+        BigInteger square = root * root;
+        PrimalityResult sq = primality_test(square);
+        CHECK(!sq.probablePrime && (sq.reason != PrimalityReason::PerfectSquare || sq.witness == root), "square of " << root.toDecimal());
+    }
+
+    // extra random rounds are reproducible from the seed or the generator
+    for (BigInteger n : {mersenne127, decimal("302231454903657293676551")}) {
+        PrimalityOptions options;
+        options.rounds = 8;
+        options.seed = 99;
+        CHECK(primality_test(n, options).probablePrime, "random rounds on " << n.toDecimal());
+        mt19937_64 g1(5), g2(5);
+        options.rng = &g1;
+        PrimalityResult r1 = primality_test(n, options);
+        options.rng = &g2;
+        PrimalityResult r2 = primality_test(n, options);
+        CHECK(r1.probablePrime && r2.probablePrime && g1() == g2(), "seeded generators advance alike on " << n.toDecimal());
+        CHECK(is_probable_prime(n, 8, &g1) && is_probable_prime(n, 8, &g2) && g1() == g2(), "is_probable_prime with a generator");
+    }
+}
+
+void test_batch_primality() {
+    BigInteger p1024 = generate_large_prime(1024), p1100 = generate_large_prime(1100), p64 = generate_large_prime(64);
+    vector<BigInteger> batch = {BigInteger(0ll), BigInteger(1ll), BigInteger(2ll), BigInteger(-7ll), BigInteger(541ll), BigInteger(292661ll),
+                                decimal("3825123056546413051"), decimal("318665857834031151167461"), p64, p64 * p64, p1024, p1100,
+                                p1024 * BigInteger(3ll), p1100 * BigInteger(32749ll), p1024 * BigInteger(32771ll), p1024 * p64};
+    // sizes either side of the 1024-bit grouping, mostly composite
+    for (int i = 0; i < 150; i++) {
+        batch.push_back(random_odd(i % 3 == 0 ? 1000 + rng() % 1200 : 20 + rng() % 600));
+    }
+    shuffle(batch.begin(), batch.end(), rng);
+    for (int threads : {0, 1, 3}) {
+        vector<bool> result = batch_is_probable_prime(batch, threads);
+        CHECK(result.size() == batch.size(), "batch of " << batch.size() << " gave " << result.size() << " results");
+        for (size_t i = 0; i < batch.size() && i < result.size(); i++) {
+            CHECK(result[i] == primality_test(batch[i]).probablePrime, "batch result for " << batch[i].toDecimal() << " on " << threads << " threads");
+        }
+    }
+    CHECK(batch_is_probable_prime(vector<BigInteger>()).empty(), "empty batch");
+
+    // enough small values to fill several chunks of the small group
+    vector<BigInteger> small;
+    for (ll v = -5; v < 300; v++) {
+        small.push_back(BigInteger(v));
+    }
+    vector<bool> result = batch_is_probable_prime(small, 2);
+    bool ok = result.size() == small.size();
+    for (size_t i = 0; ok && i < small.size(); i++) {
+        ll v = (ll)i - 5;
+        ok = result[i] == (v >= 2 && is_prime_small(v));
+    }
+    CHECK(ok, "batch of small values");
+}
+
+// the library throws string literals; count one as a failure of the group that threw it
+// heap resource that counts the blocks it has handed out and not yet taken back
+struct CountingResource : std::pmr::memory_resource {
+    long live = 0, total = 0;
+
+    void *do_allocate(size_t bytes, size_t align) override {
+        live++;
+        total++;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t align) override {
+        live--;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void test_scratch_scope() {
+    BigInteger a = random_number(3000), b = random_number(2500), m = random_odd(1024);
+    BigInteger e = random_number(1024);
+    BigInteger product = ref_product(a, b), power = ref_pow_mod(a, e, m);
+    string dec = ref_decimal(a);
+
+    vector<BigInteger> candidates;
+    for (int i = 0; i < 40; i++) {
+        candidates.push_back(random_odd(1 + rng() % 40));
+    }
+    vector<bool> primes;
+    RsaPrivateKey key = RsaPrivateKey::generate(512);
+    BigInteger message = random_number(500) % key.modulus(), cipher = key.encrypt(message);
+
+    // results assigned to values created outside the scope keep their own storage
+    BigInteger kept, outside = random_number(2000);
+    {
+        ScratchScope scope(1 << 12);
+        BigInteger p = a * b;
+        kept = p;
+        outside = a.powMod(e, m);
+        CHECK(a.toDecimal() == dec, "toDecimal inside a scratch scope");
+        primes = batch_is_probable_prime(candidates);
+        // the decrypt worker must not write into values backed by this thread's arena
+        for (int i = 0; i < 20; i++) {
+            BigInteger busy = a * b;
+            CHECK(same_value(key.decrypt(cipher, true), message) && busy == product, "parallel decrypt inside a scratch scope");
+        }
+        {
+            ScratchScope nested;
+            BigInteger q = p / b;
+            CHECK(q == a, "division in a nested scope");
+        }
+        // loop temporaries roll the arena back
+        BigInteger sum(0ll);
+        for (int i = 0; i < 200; i++) {
+            sum += a * BigInteger((ll)i);
+        }
+        CHECK(sum == a * BigInteger(19900ll), "loop inside a scratch scope");
+    }
+    // a later scope reuses and overwrites the arena
+    {
+        ScratchScope scope;
+        vector<BigInteger> junk;
+        for (int i = 0; i < 100; i++) {
+            junk.push_back(BigInteger(-1ll) << (3000 + i * 50));
+        }
+    }
+    CHECK(kept == product && same_value(outside, power), "values assigned out of a scratch scope");
+    CHECK(a * b == product && a.toDecimal() == dec && BigInteger::fromDecimal(dec) == a, "operations after scratch scopes");
+    bool same = true;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        same = same && primes[i] == primality_test(candidates[i]).probablePrime;
+    }
+    CHECK(same && batch_is_probable_prime(candidates) == primes, "primality batch after scratch scopes");
+
+    // a scope far above the retained size, then releases inside and outside a scope
+    {
+        ScratchScope scope;
+        BigInteger huge = random_number(1 << 24);
+        CHECK((huge + huge) - huge == huge && same_value(huge % m, (huge - m) % m), "operations on a scratch arena above the retained size");
+        ScratchScope::releaseMemory();
+        CHECK(huge.bitLength() == 1 << 24 && (huge << 1) == huge + huge, "releaseMemory inside a scope keeps the arena");
+    }
+    ScratchScope::releaseMemory();
+    ScratchScope::releaseMemory();
+    {
+        ScratchScope scope(1 << 10);
+        CHECK(a * b == product, "scratch scope after releaseMemory");
+    }
+
+    // LimbResourceScope routes new storage to the resource, and assignment copies it out
+    CountingResource counting;
+    BigInteger copied;
+    {
+        LimbResourceScope scope(&counting);
+        BigInteger x = a * b;
+        CHECK(counting.total > 0, "allocations go through the installed resource");
+        {
+            LimbResourceScope heap(nullptr);
+            long before = counting.total;
+            BigInteger y = a * b;
+            CHECK(counting.total == before && y == x, "LimbResourceScope(nullptr) restores the heap");
+        }
+        copied = x;
+        BigInteger moved = move(x);
+        CHECK(moved == product, "move inside a resource scope");
+    }
+    CHECK(counting.live == 0, counting.live << " blocks still held by the resource");
+    CHECK(copied == product, "value copied out of a resource scope");
+}
+
+void run(const char *name, void (*test)()) {
+    try {
+        test();
+    } catch (const char *e) {
+        failures++;
+        cout << "FAIL " << name << " threw \"" << e << "\"" << endl;
+    }
+}
+
+int main() {
+    // first, so that the process-wide caches are built inside its scopes
+    run("scratch scope", test_scratch_scope);
+    run("limb kernels", test_limb_kernels);
+    run("limbs", test_limbs);
+    run("legacy digits", test_legacy_digits);
+    run("small buffer", test_small_buffer);
+    run("add and subtract", test_add_sub);
+    run("multiply", test_multiply);
+    run("compound operators", test_compound);
+    run("divide", test_divide);
+    run("reciprocal", test_reciprocal);
+    run("shifts", test_shifts);
+    run("modular arithmetic", test_mod_arithmetic);
+    run("montgomery", test_montgomery);
+    run("barrett", test_barrett);
+    run("fixed-width", test_fixed_bigint);
+    run("windowed pow", test_windowed_pow);
+    run("fixed-base pow", test_fixed_base);
+    run("constant time", test_constant_time);
+    run("gcd", test_gcd);
+    run("modular inverse", test_mod_inverse);
+    run("decimal", test_decimal);
+    run("hex and bytes", test_hex_bytes);
+    run("radix", test_radix);
+    run("miller-rabin", test_miller_rabin);
+    run("primality", test_primality);
+    run("batch primality", test_batch_primality);
+    run("prime generation", test_prime_generation);
+    run("rsa", test_rsa);
+    if (failures) {
+        cout << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "all tests passed" << endl;
+    return 0;
+}
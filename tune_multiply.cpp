@@ -0,0 +1,73 @@
+/*
+    Description: Measures the Karatsuba, Toom-3 and NTT crossover points of BigInteger multiplication
+on the host CPU and prints the thresholds to pass to setMultiplyThresholds().
+
+    Build: g++ -O2 -std=c++20 tune_multiply.cpp -o tune_multiply
+*/
+
+#include "BigInteger.cpp"
+
+const int SAMPLES = 5;
+
+BigInteger random_number(mt19937_64 &rng, int limbs) {
+    vector<TYPE> d(limbs);
+    for (TYPE &x : d) {
+        x = rng();
+    }
+    d.back() |= 1;
+    BigInteger res;
+    res.setLimbs(d);
+    return res;
+}
+
+// best of SAMPLES runs, in nanoseconds per product
+double time_multiply(const BigInteger &a, const BigInteger &b, const MultiplyThresholds &t) {
+    setMultiplyThresholds(t);
+    double best = 1e18;
+    for (int s = 0; s < SAMPLES; s++) {
+        int reps = 0;
+        auto start = chrono::steady_clock::now();
+        auto now = start;
+        do {
+            BigInteger c = a * b;
+            reps++;
+            now = chrono::steady_clock::now();
+        } while (now - start < chrono::milliseconds(2));
+        best = min(best, chrono::duration<double, nano>(now - start).count() / reps);
+    }
+    return best;
+}
+
+// smallest size at which running one level of the faster tier beats the slower one
+// for two consecutive sizes in a row
+int find_crossover(mt19937_64 &rng, int from, int to, MultiplyThresholds slow,
+                   int MultiplyThresholds::*tier, const char *name) {
+    int wins = 0;
+    for (int n = from; n <= to; n += max(1, n / 16)) {
+        BigInteger a = random_number(rng, n), b = random_number(rng, n);
+        MultiplyThresholds fast = slow;
+        fast.*tier = n;
+        double t_slow = time_multiply(a, b, slow);
+        double t_fast = time_multiply(a, b, fast);
+        cout << "  " << name << " n=" << n << "  " << t_slow << " ns vs " << t_fast << " ns" << endl;
+        wins = t_fast < t_slow ? wins + 1 : 0;
+        if (wins == 2) return n;
+    }
+    return to;
+}
+
+int main() {
+    mt19937_64 rng(12345);
+    MultiplyThresholds t;
+    t.karatsuba = t.toom3 = t.ntt = INT32_MAX;
+
+    t.karatsuba = find_crossover(rng, 8, 600, t, &MultiplyThresholds::karatsuba, "karatsuba");
+    t.toom3 = find_crossover(rng, 3 * t.karatsuba / 2, 600, t, &MultiplyThresholds::toom3, "toom3");
+    t.ntt = find_crossover(rng, 2 * t.toom3, 20000, t, &MultiplyThresholds::ntt, "ntt");
+
+    cout << "karatsuba = " << t.karatsuba << " limbs (" << t.karatsuba * BIT_PER_DIGIT << " bits)" << endl;
+    cout << "toom3     = " << t.toom3 << " limbs (" << t.toom3 * BIT_PER_DIGIT << " bits)" << endl;
+    cout << "ntt       = " << t.ntt << " limbs (" << t.ntt * BIT_PER_DIGIT << " bits)" << endl;
+    cout << "setMultiplyThresholds({" << t.karatsuba << ", " << t.toom3 << ", " << t.ntt << "});" << endl;
+    return 0;
+}